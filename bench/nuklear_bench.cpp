@@ -0,0 +1,180 @@
+/*
+ * LOVE-Nuklear - MIT licensed; no warranty implied; use at your own risk.
+ *
+ * Headless benchmark: builds synthetic UIs through the Lua API, draws
+ * them with the record backend and reports the cost per widget and per
+ * command. Usage: nuklear_bench [frames]
+ */
+
+#include "wrap_Nuklear.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *stub_script = R"lua(
+love = love or {}
+love.timer = {getDelta = function() return 1 / 60 end}
+love.system = {
+	getClipboardText = function() return '' end,
+	setClipboardText = function(text) end
+}
+)lua";
+
+static const char *scenario_script = R"lua(
+local items = {}
+for i = 1, 100000 do
+	items[i] = 'Item ' .. i
+end
+local combo = {value = 1}
+local text = string.rep('The quick brown fox jumps over the lazy dog. ', 40)
+
+-- window height that lays out every row, so no widget is clipped
+-- (nuklear keeps coordinates in shorts, so stay below 32767)
+local function fit(rows, height)
+	return rows * (height + 8) + 64
+end
+
+scenarios = {
+	{name = '1k buttons', widgets = 1000, frame = function()
+		if nk.windowBegin('Buttons', 0, 0, 800, fit(250, 20)) then
+			nk.layoutRow('dynamic', 20, 4)
+			for i = 1, 1000 do
+				nk.button('Button')
+			end
+		end
+		nk.windowEnd()
+	end},
+	{name = '10k labels', widgets = 10000, frame = function()
+		if nk.windowBegin('Labels', 0, 0, 800, fit(1000, 20)) then
+			nk.layoutRow('dynamic', 20, 10)
+			for i = 1, 10000 do
+				nk.label('Label')
+			end
+		end
+		nk.windowEnd()
+	end},
+	{name = '50 windows', widgets = 200, frame = function()
+		for i = 1, 50 do
+			if nk.windowBegin('Window ' .. i, (i % 10) * 80, math.floor(i / 10) * 120,
+					200, 150, 'border', 'title', 'movable') then
+				nk.layoutRow('dynamic', 20, 1)
+				nk.label('Label')
+				nk.button('Button')
+				nk.label('Label')
+				nk.button('Button')
+			end
+			nk.windowEnd()
+		end
+	end},
+	{name = '100k-item combobox', widgets = 1, frame = function()
+		if nk.windowBegin('Combobox', 0, 0, 400, 300) then
+			nk.layoutRow('dynamic', 30, 1)
+			nk.combobox(combo, items)
+		end
+		nk.windowEnd()
+	end},
+	{name = '500 shapes', widgets = 500, frame = function()
+		if nk.windowBegin('Shapes', 0, 0, 800, 600) then
+			for i = 0, 99 do
+				local x, y = (i % 10) * 80, math.floor(i / 10) * 60
+				nk.line(x, y, x + 70, y, x + 70, y + 50)
+				nk.curve(x, y + 50, x + 20, y, x + 50, y + 50, x + 70, y)
+				nk.polygon('fill', x, y + 50, x + 35, y, x + 70, y + 50)
+				nk.circle('line', x + 35, y + 25, 20)
+				nk.arc('fill', x + 35, y + 25, 10, 0, math.pi)
+			end
+		end
+		nk.windowEnd()
+	end},
+	{name = 'wrapped text', widgets = 20, frame = function()
+		if nk.windowBegin('Text', 0, 0, 400, fit(20, 600)) then
+			nk.layoutRow('dynamic', 600, 1)
+			for i = 1, 20 do
+				nk.label(text, 'wrap')
+			end
+		end
+		nk.windowEnd()
+	end},
+}
+
+function bench_frame(i)
+	nk.frameBegin()
+	scenarios[i].frame()
+	nk.frameEnd()
+	nk.draw()
+end
+
+function bench_commands()
+	local count = 0
+	for _, n in pairs(nk.getStats().commands) do
+		count = count + n
+	end
+	nk.takeRecording()
+	return count
+end
+)lua";
+
+static void bench_check(lua_State *L, int status)
+{
+	if (status != 0) {
+		fprintf(stderr, "nuklear_bench: %s\n", lua_tostring(L, -1));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void bench_call(lua_State *L, const char *name, int index, int results)
+{
+	lua_getglobal(L, name);
+	if (index > 0)
+		lua_pushinteger(L, index);
+	bench_check(L, lua_pcall(L, index > 0 ? 1 : 0, results, 0));
+}
+
+int main(int argc, char **argv)
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 200;
+	lua_State *L = luaL_newstate();
+	luaL_openlibs(L);
+	bench_check(L, luaL_dostring(L, stub_script));
+	lua_pushcfunction(L, luaopen_nuklear);
+	bench_check(L, lua_pcall(L, 0, 1, 0));
+	lua_setglobal(L, "nk");
+	bench_check(L, luaL_dostring(L, scenario_script));
+	bench_check(L, luaL_dostring(L, "nk.init({backend = 'record', ['max combobox items'] = 100000})"));
+
+	lua_getglobal(L, "scenarios");
+	int count = (int) lua_objlen(L, -1);
+	int i, frame;
+	printf("%-20s %14s %14s %12s\n", "scenario", "ns/frame", "ns/widget", "ns/command");
+	for (i = 1; i <= count; ++i) {
+		lua_rawgeti(L, -1, i);
+		lua_getfield(L, -1, "name");
+		const char *name = lua_tostring(L, -1);
+		lua_getfield(L, -2, "widgets");
+		double widgets = lua_tonumber(L, -1);
+		for (frame = 0; frame < 10; ++frame) {
+			bench_call(L, "bench_frame", i, 0);
+			bench_call(L, "bench_commands", 0, 1);
+			lua_pop(L, 1);
+		}
+		double elapsed = 0, commands = 0;
+		for (frame = 0; frame < frames; ++frame) {
+			auto start = std::chrono::steady_clock::now();
+			bench_call(L, "bench_frame", i, 0);
+			auto end = std::chrono::steady_clock::now();
+			elapsed += std::chrono::duration<double, std::nano>(end - start).count();
+			bench_call(L, "bench_commands", 0, 1);
+			commands += lua_tonumber(L, -1);
+			lua_pop(L, 1);
+		}
+		printf("%-20s %14.0f %14.1f %12.1f\n", name, elapsed / frames,
+			elapsed / (widgets * frames), commands > 0 ? elapsed / commands : 0.0);
+		lua_pop(L, 3);
+	}
+	lua_pop(L, 1);
+
+	bench_check(L, luaL_dostring(L, "nk.shutdown()"));
+	lua_close(L);
+	return 0;
+}
@@ -6,11 +6,18 @@
 
 #include "wrap_Nuklear.h"
 
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <common/runtime.h>
 
+#include <modules/graphics/Canvas.h>
 #include <modules/graphics/Graphics.h>
+#include <modules/graphics/Mesh.h>
+#include <modules/graphics/Quad.h>
+#include <modules/graphics/Text.h>
+#include <modules/timer/Timer.h>
 
 #include "Nuklear.h"
 
@@ -19,6 +26,9 @@
 #define NK_INCLUDE_STANDARD_IO
 #define NK_INCLUDE_STANDARD_VARARGS
 #define NK_INCLUDE_DEFAULT_ALLOCATOR
+#define NK_INCLUDE_VERTEX_BUFFER_OUTPUT
+#define NK_UINT_DRAW_INDEX
+#define NK_ZERO_COMMAND_MEMORY
 #define NK_PRIVATE
 #define NK_BUTTON_BEHAVIOR_STACK_SIZE 32
 #define NK_FONT_STACK_SIZE 32
@@ -37,37 +47,522 @@
  * ===============================================================
  */
 
-#define NK_LOVE_MAX_POINTS 1024
 #define NK_LOVE_EDIT_BUFFER_LEN (1024 * 1024)
 #define NK_LOVE_COMBOBOX_MAX_ITEMS 1024
 #define NK_LOVE_MAX_FONTS 1024
-#define NK_LOVE_MAX_RATIOS 1024
+#define NK_LOVE_FONT_CHUNK_SIZE 32
+#define NK_LOVE_ARC_TOLERANCE 0.25f
+#define NK_LOVE_MIN_SEGMENTS 4
+#define NK_LOVE_MAX_SEGMENTS 256
+#define NK_LOVE_CURVE_TOLERANCE 0.25f
+#define NK_LOVE_ARENA_CHUNK_SIZE (64 * 1024)
+#define NK_LOVE_QUAD_CACHE_SIZE 256
+#define NK_LOVE_QUAD_CACHE_TTL 120
+#define NK_LOVE_WIDTH_CACHE_SIZE 256
+#define NK_LOVE_WIDTH_CACHE_PROBE 8
+#define NK_LOVE_FONT_TTL 120
+#define NK_LOVE_GLYPH_CACHE_SIZE 256
+#define NK_LOVE_KERNING_CACHE_SIZE 512
+#define NK_LOVE_TEXT_CACHE_SIZE 1024
+#define NK_LOVE_TEXT_CACHE_TTL 120
+#define NK_LOVE_SYNTHETIC_FONT_HEIGHT 16
+#define NK_LOVE_MAX_LAYERS 128
+#define NK_LOVE_RECORD_LIMIT (16 * 1024 * 1024)
+#define NK_LOVE_INPUT_MAGIC "NKIN"
+#define NK_LOVE_MAX_POINTS 65535
+#define NK_LOVE_POOL_MIN_SHIFT 6
+#define NK_LOVE_POOL_MAX_SHIFT 24
+#define NK_LOVE_POOL_CLASSES (NK_LOVE_POOL_MAX_SHIFT - NK_LOVE_POOL_MIN_SHIFT + 1)
 
 static lua_State *L;
 static struct nk_context context;
-static struct nk_user_font *fonts;
 static int font_count;
 static char *edit_buffer;
+static nk_size edit_buffer_size;
+static void *context_memory;
 static const char **combobox_items;
+static nk_size combobox_capacity;
 static struct nk_cursor cursors[NK_CURSOR_COUNT];
-static float *floats;
-static int layout_ratio_count;
+
+/*
+ * Limits set by nk.init. The buffers behind them are allocated on first
+ * use and grow with demand up to the limit.
+ */
+static nk_size edit_buffer_len;
+static int max_fonts;
+static int combobox_max_items;
 
 static love::graphics::Graphics *lg;
 
+enum nk_love_renderer {NK_LOVE_IMMEDIATE, NK_LOVE_BATCHED};
+enum nk_love_cache {NK_LOVE_CACHE_NONE, NK_LOVE_CACHE_FRAME, NK_LOVE_CACHE_WINDOW};
+enum nk_love_backend_type {NK_LOVE_BACKEND_GRAPHICS, NK_LOVE_BACKEND_RECORD};
+enum nk_love_allocator_type {NK_LOVE_ALLOCATOR_DEFAULT, NK_LOVE_ALLOCATOR_POOL};
+
+/*
+ * Consumer of the command list built each frame. The graphics backend
+ * draws it with love.graphics, the record backend serializes it so the
+ * module can run without a window or GPU.
+ */
+struct nk_love_backend {
+	void (*begin)(void);
+	void (*draw)(void);
+	void (*end)(void);
+};
+
+struct nk_love_vertex {
+	float position[2];
+	float uv[2];
+	nk_byte col[4];
+};
+
+static const struct nk_draw_vertex_layout_element vertex_layout[] = {
+	{NK_VERTEX_POSITION, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_love_vertex, position)},
+	{NK_VERTEX_TEXCOORD, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_love_vertex, uv)},
+	{NK_VERTEX_COLOR, NK_FORMAT_R8G8B8A8, NK_OFFSETOF(struct nk_love_vertex, col)},
+	{NK_VERTEX_LAYOUT_END}
+};
+
+static enum nk_love_renderer renderer;
+static struct nk_convert_config convert_config;
+static struct nk_draw_list draw_list;
+static struct nk_buffer draw_commands;
+static struct nk_buffer draw_vertices;
+static struct nk_buffer draw_elements;
+static struct nk_rect draw_clip;
+static struct nk_rect draw_screen;
+static love::graphics::Mesh *draw_mesh;
+static int draw_mesh_capacity;
+static love::graphics::Mesh *gradient_mesh;
+
+/*
+ * Hash of the command list built by the last frame, and of the commands
+ * currently rendered into frame_canvas.
+ */
+static enum nk_love_cache frame_cache;
+static enum nk_love_backend_type backend_type;
+static struct nk_buffer record_buffer;
+static nk_size record_frame;
+static nk_uint record_count;
+static nk_uint record_frames;
+static int record_failed;
+static FILE *record_file;
+static nk_size record_limit;
+/*
+ * Input log written by nk.recordBegin and read back by nk.replay: a magic
+ * number followed by one type byte per event, each with its nk_input_*
+ * arguments. Frame events carry the delta time of the frame they begin.
+ */
+enum nk_love_input_type {
+	NK_LOVE_INPUT_FRAME,
+	NK_LOVE_INPUT_KEY,
+	NK_LOVE_INPUT_BUTTON,
+	NK_LOVE_INPUT_MOTION,
+	NK_LOVE_INPUT_UNICODE,
+	NK_LOVE_INPUT_SCROLL
+};
+
+static FILE *input_file;
+static int input_replaying;
+static float input_delta;
+static unsigned long long frame_hash;
+static int frame_changed;
+static int frame_hash_requested;
+static love::graphics::Canvas *frame_canvas;
+static unsigned long long frame_canvas_hash;
+
+/*
+ * Off-screen copy of a run of commands belonging to one window: the
+ * window itself, or one of its popups, which are drawn after all windows.
+ */
+struct nk_love_layer {
+	struct nk_window *window;
+	nk_hash name;
+	int index;
+	unsigned long long hash;
+	int x, y, w, h;
+	love::graphics::Canvas *canvas;
+	unsigned int frame;
+};
+
+static struct nk_love_layer layers[NK_LOVE_MAX_LAYERS];
+static struct nk_vec2 draw_offset;
+
+struct nk_love_quad_entry {
+	love::graphics::Quad *quad;
+	unsigned short key[6];
+	unsigned int frame;
+};
+
+static struct nk_love_quad_entry quad_cache[NK_LOVE_QUAD_CACHE_SIZE];
+static int quad_cache_count;
+static unsigned int frame_count;
+
+struct nk_love_width_entry {
+	unsigned long long key;
+	float width;
+	int referenced;
+};
+
+struct nk_love_glyph_entry {
+	nk_rune codepoint;
+	float advance;
+};
+
+struct nk_love_kerning_entry {
+	unsigned long long pair;
+	float kerning;
+};
+
+/*
+ * Per-font record shared by every nk_user_font slot that uses the same
+ * LOVE font. Measured widths are memoized here, so the cache goes away
+ * together with the font it belongs to. Unreferenced records linger for
+ * NK_LOVE_FONT_TTL frames so fonts pushed every frame keep their cache.
+ */
+struct nk_love_font {
+	love::graphics::Font *font;
+	int refs;
+	unsigned int frame;
+	struct nk_love_width_entry widths[NK_LOVE_WIDTH_CACHE_SIZE];
+	/* advances below 256 are dense, a negative value means not yet known */
+	float latin1[256];
+	struct nk_love_glyph_entry glyphs[NK_LOVE_GLYPH_CACHE_SIZE];
+	struct nk_love_kerning_entry kernings[NK_LOVE_KERNING_CACHE_SIZE];
+	unsigned int width_hits;
+	unsigned int width_misses;
+	struct nk_love_font *next;
+};
+
+static struct nk_love_font *font_records;
+
+/* width cache counts of records already swept */
+static unsigned int font_width_hits;
+static unsigned int font_width_misses;
+
+struct nk_love_text_entry {
+	love::graphics::Text *text;
+	love::graphics::Font *font;
+	unsigned long long key;
+	char *string;
+	int len;
+	unsigned int frame;
+};
+
+static struct nk_love_text_entry *text_cache;
+static unsigned int text_cache_capacity;
+static unsigned int text_cache_count;
+static love::graphics::Text *text_uncached;
+
+/*
+ * Shadow copy of the graphics state last set by the draw loop, used to
+ * skip love::graphics calls that would not change anything.
+ */
+struct nk_love_draw_state {
+	struct nk_color color;
+	float line_width;
+	love::Rect scissor;
+	int has_color;
+	int has_line_width;
+	int has_scissor;
+};
+
+struct nk_love_stats {
+	int state_changes;
+	int state_changes_skipped;
+	int quads_created;
+	int quad_cache_hits;
+	int texts_created;
+	int text_cache_hits;
+	int frames_rendered;
+	int frames_reused;
+	int layers_rendered;
+	int layers_reused;
+	int commands_culled;
+	int record_frames_dropped;
+	int commands[NK_COMMAND_CUSTOM + 1];
+	int draw_calls;
+	nk_size memory_used;
+	nk_size memory_size;
+	nk_size memory_needed;
+	nk_size memory_calls;
+	int pool_allocations;
+	int pool_frees;
+	int pool_system_allocations;
+	nk_size pool_live_bytes;
+	nk_size pool_peak_bytes;
+	double draw_time;
+};
+
+/* Counters for the part of the frame between nk.frameBegin and nk.frameEnd. */
+struct nk_love_build_stats {
+	int text_width_calls;
+	int text_width_hits;
+	int text_width_misses;
+	double frame_begin_time;
+	double build_start;
+	double build_time;
+};
+
+static const char *command_names[NK_COMMAND_CUSTOM + 1] = {
+	"nop", "scissor", "line", "curve", "rect", "rect filled",
+	"rect multi color", "circle", "circle filled", "arc", "arc filled",
+	"triangle", "triangle filled", "polygon", "polygon filled", "polyline",
+	"text", "image", "custom"
+};
+
+static struct nk_love_draw_state draw_state;
+static struct nk_love_stats stats;
+static struct nk_love_build_stats build_stats;
+
+/*
+ * Timing zones collected when built with NK_LOVE_TRACE, kept in a ring
+ * buffer and written out by nk.dumpTrace.
+ */
+#ifdef NK_LOVE_TRACE
+#define NK_LOVE_TRACE_SIZE 65536
+
+struct nk_love_trace_event {
+	const char *name;
+	double start;
+	double duration;
+};
+
+static struct nk_love_trace_event trace_events[NK_LOVE_TRACE_SIZE];
+static unsigned int trace_head;
+static unsigned int trace_count;
+
+static void nk_love_trace_zone(const char *name, double start)
+{
+	struct nk_love_trace_event *event = &trace_events[trace_head];
+	event->name = name;
+	event->start = start;
+	event->duration = love::timer::Timer::getTime() - start;
+	trace_head = (trace_head + 1) % NK_LOVE_TRACE_SIZE;
+	if (trace_count < NK_LOVE_TRACE_SIZE)
+		trace_count++;
+}
+
+#define NK_LOVE_ZONE_BEGIN(var) double var = love::timer::Timer::getTime()
+#define NK_LOVE_ZONE_END(name, var) nk_love_trace_zone(name, var)
+#else
+#define NK_LOVE_ZONE_BEGIN(var) ((void) 0)
+#define NK_LOVE_ZONE_END(name, var) ((void) 0)
+#endif
+
+/*
+ * Scratch memory that lives until the next arena reset. Allocation is a
+ * pointer bump; when a chunk runs out another one is chained in front,
+ * and the reset folds them all into a single chunk big enough for the
+ * whole peak, so a steady workload stops allocating.
+ */
+struct nk_love_arena_chunk {
+	struct nk_love_arena_chunk *next;
+	nk_size size;
+	nk_size used;
+};
+
+static struct nk_love_arena_chunk *arena;
+
+static void *nk_love_arena_alloc(nk_size size)
+{
+	size = (size + 15) & ~(nk_size) 15;
+	if (!arena || arena->used + size > arena->size) {
+		nk_size chunk_size = NK_LOVE_ARENA_CHUNK_SIZE;
+		if (arena)
+			chunk_size = NK_MAX(chunk_size, arena->size * 2);
+		chunk_size = NK_MAX(chunk_size, size);
+		struct nk_love_arena_chunk *chunk = (struct nk_love_arena_chunk *)
+			malloc(sizeof(struct nk_love_arena_chunk) + 15 + chunk_size);
+		if (!chunk)
+			return NULL;
+		chunk->next = arena;
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		arena = chunk;
+	}
+	char *data = (char *) (arena + 1);
+	data = (char *) (((nk_size) data + 15) & ~(nk_size) 15);
+	void *mem = data + arena->used;
+	arena->used += size;
+	return mem;
+}
+
+static void nk_love_arena_reset(int release)
+{
+	nk_size total = 0;
+	int chunks = 0;
+	struct nk_love_arena_chunk *chunk = arena;
+	while (chunk) {
+		struct nk_love_arena_chunk *next = chunk->next;
+		total += chunk->size;
+		chunks++;
+		chunk = next;
+	}
+	if (chunks == 1 && !release) {
+		arena->used = 0;
+		return;
+	}
+	while (arena) {
+		chunk = arena->next;
+		free(arena);
+		arena = chunk;
+	}
+	if (!release && total > 0 && nk_love_arena_alloc(total))
+		arena->used = 0;
+}
+
+/*
+ * Allocator for the context and draw buffers. Blocks are rounded up to a
+ * power of two and kept on a free list per size class when freed, so once
+ * the buffers have grown to their steady size nothing reaches malloc. A
+ * block already big enough for a reallocation is handed back as is.
+ */
+struct nk_love_pool_block {
+	struct nk_love_pool_block *next;
+	nk_size size;
+};
+
+struct nk_love_pool {
+	struct nk_love_pool_block *free_blocks[NK_LOVE_POOL_CLASSES];
+	int allocations;
+	int frees;
+	int system_allocations;
+	nk_size live_bytes;
+	nk_size peak_bytes;
+};
+
+static enum nk_love_allocator_type allocator_type;
+static struct nk_love_pool pool;
+
+static int nk_love_pool_class(nk_size size)
+{
+	int size_class = 0;
+	while (((nk_size) 1 << (size_class + NK_LOVE_POOL_MIN_SHIFT)) < size)
+		size_class++;
+	return size_class;
+}
+
+static void *nk_love_pool_alloc(nk_handle handle, void *old, nk_size size)
+{
+	(void)handle;
+	pool.allocations++;
+	struct nk_love_pool_block *block;
+	if (old) {
+		block = (struct nk_love_pool_block *) old - 1;
+		if (block->size >= size)
+			return old;
+	}
+	int size_class = nk_love_pool_class(size);
+	nk_size capacity = size;
+	if (size_class < NK_LOVE_POOL_CLASSES)
+		capacity = (nk_size) 1 << (size_class + NK_LOVE_POOL_MIN_SHIFT);
+	if (size_class < NK_LOVE_POOL_CLASSES && pool.free_blocks[size_class]) {
+		block = pool.free_blocks[size_class];
+		pool.free_blocks[size_class] = block->next;
+	} else {
+		block = (struct nk_love_pool_block *) malloc(sizeof(struct nk_love_pool_block) + capacity);
+		if (!block)
+			return NULL;
+		pool.system_allocations++;
+	}
+	block->next = NULL;
+	block->size = capacity;
+	pool.live_bytes += capacity;
+	pool.peak_bytes = NK_MAX(pool.peak_bytes, pool.live_bytes);
+	return block + 1;
+}
+
+static void nk_love_pool_free(nk_handle handle, void *old)
+{
+	(void)handle;
+	if (!old)
+		return;
+	pool.frees++;
+	struct nk_love_pool_block *block = (struct nk_love_pool_block *) old - 1;
+	pool.live_bytes -= block->size;
+	int size_class = nk_love_pool_class(block->size);
+	if (size_class < NK_LOVE_POOL_CLASSES) {
+		block->next = pool.free_blocks[size_class];
+		pool.free_blocks[size_class] = block;
+	} else {
+		free(block);
+	}
+}
+
+static void nk_love_pool_release(void)
+{
+	int i;
+	for (i = 0; i < NK_LOVE_POOL_CLASSES; ++i) {
+		while (pool.free_blocks[i]) {
+			struct nk_love_pool_block *next = pool.free_blocks[i]->next;
+			free(pool.free_blocks[i]);
+			pool.free_blocks[i] = next;
+		}
+	}
+	nk_zero_struct(pool);
+}
+
+static const struct nk_allocator pool_allocator = {{0}, nk_love_pool_alloc, nk_love_pool_free};
+
+static void nk_love_buffer_init(struct nk_buffer *buffer)
+{
+	if (allocator_type == NK_LOVE_ALLOCATOR_POOL)
+		nk_buffer_init(buffer, &pool_allocator, NK_BUFFER_DEFAULT_INITIAL_SIZE);
+	else
+		nk_buffer_init_default(buffer);
+}
+
+static void nk_love_reset_state(void)
+{
+	nk_zero_struct(draw_state);
+}
+
 static void nk_love_set_color(struct nk_color col)
 {
+	if (draw_state.has_color && draw_state.color.r == col.r &&
+			draw_state.color.g == col.g && draw_state.color.b == col.b &&
+			draw_state.color.a == col.a) {
+		stats.state_changes_skipped++;
+		return;
+	}
 	lg->setColor(love::graphics::Colorf(col.r / 255.0, col.g / 255.0, col.b / 255.0, col.a / 255.0));
+	draw_state.color = col;
+	draw_state.has_color = 1;
+	stats.state_changes++;
+}
+
+static void nk_love_set_line_width(float line_width)
+{
+	if (draw_state.has_line_width && draw_state.line_width == line_width) {
+		stats.state_changes_skipped++;
+		return;
+	}
+	lg->setLineWidth(line_width);
+	draw_state.line_width = line_width;
+	draw_state.has_line_width = 1;
+	stats.state_changes++;
 }
 
 static void nk_love_configureGraphics(int line_thickness, struct nk_color col)
 {
-	lg->setLineWidth(line_thickness);
+	/* fills ignore the line width */
+	if (line_thickness >= 0)
+		nk_love_set_line_width(line_thickness);
 	nk_love_set_color(col);
 }
 
+/* Line width and color given to shapes when there is no love.graphics. */
+static float headless_line_width = 1.0f;
+static struct nk_color headless_color = {255, 255, 255, 255};
+
 static void nk_love_getGraphics(float *line_thickness, struct nk_color *color)
 {
+	if (!lg) {
+		*line_thickness = headless_line_width;
+		*color = headless_color;
+		return;
+	}
 	*line_thickness = lg->getLineWidth();
 	auto love_color = lg->getColor();
 	color->r = love_color.r;
@@ -78,12 +573,24 @@ static void nk_love_getGraphics(float *line_thickness, struct nk_color *color)
 
 static void nk_love_scissor(int x, int y, int w, int h)
 {
+	/* scissors ignore the transform, so shift them into the layer */
+	x -= (int) draw_offset.x;
+	y -= (int) draw_offset.y;
 	love::Rect rect;
 	rect.x = x;
 	rect.y = y;
 	rect.w = w;
 	rect.h = h;
+	if (draw_state.has_scissor && draw_state.scissor.x == x &&
+			draw_state.scissor.y == y && draw_state.scissor.w == w &&
+			draw_state.scissor.h == h) {
+		stats.state_changes_skipped++;
+		return;
+	}
 	lg->setScissor(rect);
+	draw_state.scissor = rect;
+	draw_state.has_scissor = 1;
+	stats.state_changes++;
 }
 
 static void nk_love_draw_line(int x0, int y0, int x1, int y1,
@@ -91,6 +598,7 @@ static void nk_love_draw_line(int x0, int y0, int x1, int y1,
 {
 	nk_love_configureGraphics(line_thickness, col);
 	float coords[] = {(float) x0, (float) y1, (float) x1, (float) y1};
+	stats.draw_calls++;
 	lg->polyline(coords, 4);
 }
 
@@ -105,6 +613,7 @@ static void nk_love_draw_rect(int x, int y, unsigned int w,
 	} else {
 		mode = love::graphics::Graphics::DrawMode::DRAW_FILL;
 	}
+	stats.draw_calls++;
 	lg->rectangle(
 		mode,
 		(float) x,
@@ -126,6 +635,7 @@ static void nk_love_draw_triangle(int x0, int y0, int x1, int y1,
 		mode = love::graphics::Graphics::DrawMode::DRAW_FILL;
 	}
 	float coords[] = { (float) x0, (float) y0, (float) x1, (float) y1, (float) x2, (float) y2};
+	stats.draw_calls++;
 	lg->polygon(mode, coords, 6);
 }
 
@@ -139,28 +649,63 @@ static void nk_love_draw_polygon(const struct nk_vec2i *pnts, int count,
 	} else {
 		mode = love::graphics::Graphics::DrawMode::DRAW_FILL;
 	}
-	float coords[NK_LOVE_MAX_POINTS*2];
+	float *coords = (float *) nk_love_arena_alloc(sizeof(float) * count * 2);
+	if (!coords)
+		return;
 	int i;
-	for (i = 0; (i < count) && (i < NK_LOVE_MAX_POINTS); ++i) {
+	for (i = 0; i < count; ++i) {
 		coords[2*i] = (float) pnts[i].x;
 		coords[2*i + 1] = (float) pnts[i].y;
 	}
+	stats.draw_calls++;
 	lg->polygon(mode, coords, i);
 }
 
 static void nk_love_draw_polyline(const struct nk_vec2i *pnts,
 	int count, int line_thickness, struct nk_color col)
 {
+	float *coords = (float *) nk_love_arena_alloc(sizeof(float) * count * 2);
+	if (!coords)
+		return;
 	nk_love_configureGraphics(line_thickness, col);
-	float coords[NK_LOVE_MAX_POINTS*2];
 	int i;
-	for (i = 0; (i < count) && (i < NK_LOVE_MAX_POINTS); ++i) {
+	for (i = 0; i < count; ++i) {
 		coords[2*i] = (float) pnts[i].x;
 		coords[2*i + 1] = (float) pnts[i].y;
 	}
+	stats.draw_calls++;
 	lg->polyline(coords, i);
 }
 
+/*
+ * Number of segments needed for an arc of the given radius and angle so
+ * that no chord strays more than NK_LOVE_ARC_TOLERANCE pixels from it.
+ */
+static int nk_love_segments(float r, float angle)
+{
+	angle = NK_ABS(angle);
+	if (r <= NK_LOVE_ARC_TOLERANCE)
+		return NK_LOVE_MIN_SEGMENTS;
+	float step = 2.0f * acosf(1.0f - NK_LOVE_ARC_TOLERANCE / r);
+	int segments = (int) ceilf(angle / step);
+	return NK_CLAMP(NK_LOVE_MIN_SEGMENTS, segments, NK_LOVE_MAX_SEGMENTS);
+}
+
+/* Segment counts configured in nk.init take precedence, zero is adaptive. */
+static int nk_love_arc_segments(float r, float angle)
+{
+	if (convert_config.arc_segment_count)
+		return convert_config.arc_segment_count;
+	return nk_love_segments(r, angle);
+}
+
+static int nk_love_circle_segments(float r)
+{
+	if (convert_config.circle_segment_count)
+		return convert_config.circle_segment_count;
+	return nk_love_segments(r, 2 * NK_PI);
+}
+
 static void nk_love_draw_circle(int x, int y, unsigned int w,
 	unsigned int h, int line_thickness, struct nk_color col)
 {
@@ -171,7 +716,25 @@ static void nk_love_draw_circle(int x, int y, unsigned int w,
 	} else {
 		mode = love::graphics::Graphics::DrawMode::DRAW_FILL;
 	}
-	lg->ellipse(mode, x + w/2, y + h/2, w/2, h/2);
+	stats.draw_calls++;
+	lg->ellipse(mode, x + w/2, y + h/2, w/2, h/2,
+		nk_love_circle_segments(NK_MAX(w, h) / 2.0f));
+}
+
+/*
+ * Wang's formula: the number of segments that keeps a cubic Bezier
+ * within NK_LOVE_CURVE_TOLERANCE pixels of its flattened polyline.
+ */
+static unsigned int nk_love_curve_segments(struct nk_vec2i p1, struct nk_vec2i p2,
+	struct nk_vec2i p3, struct nk_vec2i p4)
+{
+	if (convert_config.curve_segment_count)
+		return convert_config.curve_segment_count;
+	float ax = p1.x - 2 * p2.x + p3.x, ay = p1.y - 2 * p2.y + p3.y;
+	float bx = p2.x - 2 * p3.x + p4.x, by = p2.y - 2 * p3.y + p4.y;
+	float m = NK_MAX(sqrtf(ax * ax + ay * ay), sqrtf(bx * bx + by * by));
+	int segments = (int) ceilf(sqrtf(0.75f * m / NK_LOVE_CURVE_TOLERANCE));
+	return NK_CLAMP(1, segments, NK_LOVE_MAX_SEGMENTS);
 }
 
 static void nk_love_draw_curve(struct nk_vec2i p1, struct nk_vec2i p2,
@@ -180,14 +743,17 @@ static void nk_love_draw_curve(struct nk_vec2i p1, struct nk_vec2i p2,
 {
 	unsigned int i_step;
 	float t_step;
-	struct nk_vec2i last = p1;
 
 	if (num_segments < 1) {
 		num_segments = 1;
 	}
 	t_step = 1.0f/(float)num_segments;
+	float *coords = (float *) nk_love_arena_alloc(sizeof(float) * (num_segments + 1) * 2);
+	if (!coords)
+		return;
 	nk_love_configureGraphics(line_thickness, col);
-	float coords[num_segments * 2];
+	coords[0] = p1.x;
+	coords[1] = p1.y;
 	for (i_step = 1; i_step <= num_segments; ++i_step) {
 		float t = t_step * (float)i_step;
 		float u = 1.0f - t;
@@ -197,94 +763,309 @@ static void nk_love_draw_curve(struct nk_vec2i p1, struct nk_vec2i p2,
 		float w4 = t * t *t;
 		float x = w1 * p1.x + w2 * p2.x + w3 * p3.x + w4 * p4.x;
 		float y = w1 * p1.y + w2 * p2.y + w3 * p3.y + w4 * p4.y;
-		coords[2 * (i_step - 1)] = x;
-		coords[2 * (i_step - 1) + 1] = y;
+		coords[2 * i_step] = x;
+		coords[2 * i_step + 1] = y;
+	}
+	stats.draw_calls++;
+	lg->polyline(coords, (num_segments + 1) * 2);
+}
+
+#define NK_LOVE_HASH_SEED 14695981039346656037ULL
+
+/* 64-bit FNV-1a */
+static unsigned long long nk_love_hash(unsigned long long hash, const void *data, nk_size size)
+{
+	const unsigned char *bytes = (const unsigned char *) data;
+	nk_size i;
+	for (i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static unsigned long long nk_love_text_key(float height, const char *text, int len)
+{
+	unsigned long long hash = nk_love_hash(NK_LOVE_HASH_SEED, text, len);
+	union {float f; nk_uint u;} h;
+	h.f = height;
+	hash ^= ((unsigned long long) len << 32) | h.u;
+	hash *= 1099511628211ULL;
+	/* zero marks an empty slot */
+	return hash ? hash : 1;
+}
+
+static float nk_love_measure_glyph(love::graphics::Font *font, nk_rune codepoint)
+{
+	/* without love.graphics every glyph is half the font height wide */
+	if (!font)
+		return NK_LOVE_SYNTHETIC_FONT_HEIGHT / 2;
+	char glyph[NK_UTF_SIZE];
+	int len = nk_utf_encode(codepoint, glyph, NK_UTF_SIZE);
+	return font->getWidth(std::string(glyph, len));
+}
+
+static float nk_love_glyph_advance(struct nk_love_font *record, nk_rune codepoint)
+{
+	if (codepoint < 256) {
+		if (record->latin1[codepoint] < 0)
+			record->latin1[codepoint] = nk_love_measure_glyph(record->font, codepoint);
+		return record->latin1[codepoint];
+	}
+	unsigned int start = (codepoint * 2654435761u) % NK_LOVE_GLYPH_CACHE_SIZE;
+	unsigned int i;
+	for (i = 0; i < NK_LOVE_GLYPH_CACHE_SIZE; ++i) {
+		struct nk_love_glyph_entry *entry = &record->glyphs[(start + i) % NK_LOVE_GLYPH_CACHE_SIZE];
+		if (entry->codepoint == codepoint)
+			return entry->advance;
+		if (entry->codepoint == 0) {
+			entry->codepoint = codepoint;
+			entry->advance = nk_love_measure_glyph(record->font, codepoint);
+			return entry->advance;
+		}
+	}
+	/* table full, measure without caching */
+	return nk_love_measure_glyph(record->font, codepoint);
+}
+
+static float nk_love_glyph_kerning(struct nk_love_font *record, nk_rune left, nk_rune right)
+{
+	if (!record->font)
+		return 0;
+	unsigned long long pair = ((unsigned long long) left << 32) | right;
+	unsigned int start = (unsigned int) ((pair * 11400714819323198485ULL) >> 40) % NK_LOVE_KERNING_CACHE_SIZE;
+	unsigned int i;
+	for (i = 0; i < NK_LOVE_KERNING_CACHE_SIZE; ++i) {
+		struct nk_love_kerning_entry *entry = &record->kernings[(start + i) % NK_LOVE_KERNING_CACHE_SIZE];
+		if (entry->pair == pair)
+			return entry->kerning;
+		if (entry->pair == 0) {
+			entry->pair = pair;
+			entry->kerning = record->font->getKerning(left, right);
+			return entry->kerning;
+		}
+	}
+	return record->font->getKerning(left, right);
+}
+
+/*
+ * Sum cached advances the same way Font::getWidth does: kerning between
+ * neighbouring glyphs, and the widest line when the text has newlines.
+ */
+static float nk_love_measure_text(struct nk_love_font *record, const char *text, int len)
+{
+	float width = 0, max_width = 0;
+	nk_rune prev = 0;
+	int i = 0;
+	while (i < len) {
+		nk_rune codepoint;
+		int glyph_len = nk_utf_decode(text + i, &codepoint, len - i);
+		if (!glyph_len)
+			break;
+		i += glyph_len;
+		if (codepoint == '\n') {
+			max_width = NK_MAX(max_width, width);
+			width = 0;
+			prev = 0;
+			continue;
+		}
+		if (codepoint == '\r')
+			continue;
+		width += nk_love_glyph_advance(record, codepoint);
+		if (prev)
+			width += nk_love_glyph_kerning(record, prev, codepoint);
+		prev = codepoint;
 	}
-	lg->polyline(coords, num_segments * 2);
+	return NK_MAX(max_width, width);
 }
 
 static float nk_love_get_text_width(nk_handle handle, float height,
 	const char *text, int len)
 {
-	lua_getfield(L, LUA_REGISTRYINDEX, "nuklear");
-	lua_getfield(L, -1, "font");
-	lua_rawgeti(L, -1, handle.id);
-	love::graphics::Font *font = luax_checktype<love::graphics::Font>(L, -1);
-	lua_pop(L, 3);
-	return font->getWidth(std::string(text, len));
+	struct nk_love_font *record = (struct nk_love_font *) handle.ptr;
+	unsigned long long key = nk_love_text_key(height, text, len);
+	build_stats.text_width_calls++;
+	int start = (int) (key % NK_LOVE_WIDTH_CACHE_SIZE);
+	struct nk_love_width_entry *victim = NULL;
+	int i;
+	for (i = 0; i < NK_LOVE_WIDTH_CACHE_PROBE; ++i) {
+		struct nk_love_width_entry *entry = &record->widths[(start + i) % NK_LOVE_WIDTH_CACHE_SIZE];
+		if (entry->key == key) {
+			entry->referenced = 1;
+			record->width_hits++;
+			build_stats.text_width_hits++;
+			return entry->width;
+		}
+		if (entry->key == 0) {
+			if (!victim)
+				victim = entry;
+			break;
+		}
+	}
+	if (!victim) {
+		/* clock eviction over the probe window */
+		for (i = 0; !victim; i = (i + 1) % NK_LOVE_WIDTH_CACHE_PROBE) {
+			struct nk_love_width_entry *entry = &record->widths[(start + i) % NK_LOVE_WIDTH_CACHE_SIZE];
+			if (entry->referenced)
+				entry->referenced = 0;
+			else
+				victim = entry;
+		}
+	}
+	record->width_misses++;
+	build_stats.text_width_misses++;
+	victim->key = key;
+	victim->width = nk_love_measure_text(record, text, len);
+	victim->referenced = 0;
+	return victim->width;
 }
 
-static void nk_love_draw_text(int fontref, struct nk_color cbg,
-	struct nk_color cfg, int x, int y, unsigned int w, unsigned int h,
-	float height, int len, const char *text)
+static unsigned int nk_love_text_slot(love::graphics::Font *font, unsigned long long key,
+	unsigned int capacity)
 {
-	//nk_love_set_color(cbg);
-	//lg->rectangle(love::graphics::Graphics::DrawMode::DRAW_FILL, x, y, w, height);
-	nk_love_set_color(cfg);
+	unsigned long long hash = key ^ (unsigned long long) (size_t) font;
+	return (unsigned int) (hash ^ (hash >> 32)) & (capacity - 1);
+}
 
-	lua_getfield(L, LUA_REGISTRYINDEX, "nuklear");
-	lua_getfield(L, -1, "font");
-	lua_rawgeti(L, -1, fontref);
-	auto font = luax_checktype<love::graphics::Font>(L, -1);
-	lua_pop(L, 3);
+static void nk_love_text_cache_insert(struct nk_love_text_entry *table,
+	unsigned int capacity, const struct nk_love_text_entry *entry)
+{
+	unsigned int i = nk_love_text_slot(entry->font, entry->key, capacity);
+	while (table[i].text)
+		i = (i + 1) & (capacity - 1);
+	table[i] = *entry;
+}
 
-	lg->setFont(font);
-	std::vector<love::graphics::Font::ColoredString> str;
-	auto transform = lg->getTransform();
-	transform.translate(x, y);
-	str.push_back({text, lg->getColor()});
-	lg->print(str, transform);
+/*
+ * Release the text layouts that haven't been drawn for
+ * NK_LOVE_TEXT_CACHE_TTL frames, or all of them, and rehash the rest into
+ * a table of the given power-of-two capacity. If that table can't be
+ * allocated the old one is kept as it is.
+ */
+static void nk_love_text_cache_rebuild(unsigned int capacity, int all)
+{
+	struct nk_love_text_entry *table = NULL;
+	if (!all) {
+		table = (struct nk_love_text_entry *) calloc(capacity, sizeof(struct nk_love_text_entry));
+		if (!table)
+			return;
+	}
+	unsigned int count = 0;
+	unsigned int i;
+	for (i = 0; i < text_cache_capacity; ++i) {
+		struct nk_love_text_entry *entry = &text_cache[i];
+		if (!entry->text)
+			continue;
+		if (all || frame_count - entry->frame > NK_LOVE_TEXT_CACHE_TTL) {
+			entry->text->release();
+			free(entry->string);
+		} else {
+			nk_love_text_cache_insert(table, capacity, entry);
+			count++;
+		}
+	}
+	free(text_cache);
+	text_cache = table;
+	text_cache_capacity = all ? 0 : capacity;
+	text_cache_count = count;
 }
 
-static void interpolate_color(struct nk_color c1, struct nk_color c2,
-	struct nk_color *result, float fraction)
+static void nk_love_text_cache_sweep(int all)
 {
-	float r = c1.r + (c2.r - c1.r) * fraction;
-	float g = c1.g + (c2.g - c1.g) * fraction;
-	float b = c1.b + (c2.b - c1.b) * fraction;
-	float a = c1.a + (c2.a - c1.a) * fraction;
+	if (all) {
+		nk_love_text_cache_rebuild(0, 1);
+		if (text_uncached) {
+			text_uncached->release();
+			text_uncached = NULL;
+		}
+	} else if (text_cache_capacity) {
+		nk_love_text_cache_rebuild(text_cache_capacity, 0);
+	}
+}
+
+/*
+ * Laid out text is cached per font and string. The glyphs are white, so
+ * the color set with nk_love_set_color tints them when drawn. The table
+ * is kept at most three quarters full: stale layouts are dropped and the
+ * table doubles when it would fill up, so every string drawn in a frame
+ * stays cached however many there are.
+ */
+static love::graphics::Text *nk_love_get_text(love::graphics::Font *font,
+	const char *text, int len)
+{
+	struct nk_love_text_entry entry;
+	entry.font = font;
+	entry.key = nk_love_text_key(0, text, len);
+	if (text_cache_capacity) {
+		unsigned int i = nk_love_text_slot(font, entry.key, text_cache_capacity);
+		while (text_cache[i].text) {
+			struct nk_love_text_entry *cached = &text_cache[i];
+			if (cached->font == font && cached->key == entry.key && cached->len == len
+					&& !memcmp(cached->string, text, len)) {
+				cached->frame = frame_count;
+				stats.text_cache_hits++;
+				return cached->text;
+			}
+			i = (i + 1) & (text_cache_capacity - 1);
+		}
+	}
+	if ((text_cache_count + 1) * 4 > text_cache_capacity * 3)
+		nk_love_text_cache_rebuild(NK_MAX(text_cache_capacity * 2, NK_LOVE_TEXT_CACHE_SIZE), 0);
+	std::vector<love::graphics::Font::ColoredString> str;
+	str.push_back({std::string(text, len), love::graphics::Colorf(1, 1, 1, 1)});
+	entry.text = lg->newText(font, str);
+	entry.len = len;
+	entry.string = (char *) malloc(len ? len : 1);
+	entry.frame = frame_count;
+	stats.texts_created++;
+	if (!entry.string || (text_cache_count + 1) * 4 > text_cache_capacity * 3) {
+		/* out of memory: keep the layout only until the next uncached one */
+		free(entry.string);
+		if (text_uncached)
+			text_uncached->release();
+		text_uncached = entry.text;
+		return entry.text;
+	}
+	memcpy(entry.string, text, len);
+	nk_love_text_cache_insert(text_cache, text_cache_capacity, &entry);
+	text_cache_count++;
+	return entry.text;
+}
 
-	result->r = (nk_byte)NK_CLAMP(0, r, 255);
-	result->g = (nk_byte)NK_CLAMP(0, g, 255);
-	result->b = (nk_byte)NK_CLAMP(0, b, 255);
-	result->a = (nk_byte)NK_CLAMP(0, a, 255);
+static void nk_love_draw_text(love::graphics::Font *font, struct nk_color cbg,
+	struct nk_color cfg, int x, int y, unsigned int w, unsigned int h,
+	float height, int len, const char *text)
+{
+	//nk_love_set_color(cbg);
+	//lg->rectangle(love::graphics::Graphics::DrawMode::DRAW_FILL, x, y, w, height);
+	nk_love_set_color(cfg);
+	love::graphics::Text *layout = nk_love_get_text(font, text, len);
+	stats.draw_calls++;
+	layout->draw(lg, love::Matrix4(x, y, 0, 1, 1, 0, 0, 0, 0));
 }
 
 static void nk_love_draw_rect_multi_color(int x, int y, unsigned int w,
 	unsigned int h, struct nk_color left, struct nk_color top,
 	struct nk_color right, struct nk_color bottom)
 {
-	lg->push(love::graphics::Graphics::StackType::STACK_ALL);
-	nk_love_set_color({255, 255, 255, 255});
-	lg->setPointSize(1);
-
-	struct nk_color X1, X2, Y;
-	float fraction_x, fraction_y;
-	int i,j;
-
-	float points[h * w * 2];
-	love::graphics::Colorf colors [h * w];
-	int n = 0;
-	for (j = 0; j < h; j++) {
-		fraction_y = ((float)j) / h;
-		for (i = 0; i < w; i++) {
-			fraction_x = ((float)i) / w;
-			interpolate_color(left, top, &X1, fraction_x);
-			interpolate_color(right, bottom, &X2, fraction_x);
-			interpolate_color(X1, X2, &Y, fraction_y);
-			points[2 * n] = x + i;
-			points[2 * n + 1] = y + j;
-			colors[n].r = Y.r / 255.0;
-			colors[n].g = Y.g / 255.0;
-			colors[n].b = Y.b / 255.0;
-			colors[n].a = Y.a / 255.0;
-			n++;
-		}
+	/* nk.rectMultiColor passes the bottom corners left to right */
+	float x0 = (float) x, y0 = (float) y;
+	float x1 = x0 + (float) w, y1 = y0 + (float) h;
+	struct nk_love_vertex vertices[4] = {
+		{{x0, y0}, {0, 0}, {left.r, left.g, left.b, left.a}},
+		{{x1, y0}, {1, 0}, {top.r, top.g, top.b, top.a}},
+		{{x1, y1}, {1, 1}, {bottom.r, bottom.g, bottom.b, bottom.a}},
+		{{x0, y1}, {0, 1}, {right.r, right.g, right.b, right.a}}
+	};
+	if (!gradient_mesh) {
+		gradient_mesh = lg->newMesh(love::graphics::Mesh::getDefaultVertexFormat(),
+			4, love::graphics::PRIMITIVE_TRIANGLE_FAN,
+			love::graphics::vertex::USAGE_DYNAMIC);
 	}
-
-	lg->points(points, colors, n);
-
-	lg->pop();
+	gradient_mesh->setVertices(0, vertices, sizeof(vertices));
+	nk_love_set_color(nk_rgba(255, 255, 255, 255));
+	stats.draw_calls++;
+	gradient_mesh->draw(lg, love::Matrix4());
 }
 
 static void nk_love_clear(struct nk_color col)
@@ -298,64 +1079,549 @@ static void nk_love_blit()
 	lg->present(0);
 }
 
+static love::graphics::Texture *nk_love_get_texture(int ref)
+{
+	lua_getfield(L, LUA_REGISTRYINDEX, "nuklear");
+	lua_getfield(L, -1, "image");
+	lua_rawgeti(L, -1, ref);
+	love::graphics::Texture *texture = luax_checktype<love::graphics::Texture>(L, -1);
+	lua_pop(L, 3);
+	return texture;
+}
+
+static void nk_love_quad_cache_insert(const struct nk_love_quad_entry *entry)
+{
+	nk_hash hash = nk_murmur_hash(entry->key, sizeof(entry->key), 0);
+	int i = hash & (NK_LOVE_QUAD_CACHE_SIZE - 1);
+	while (quad_cache[i].quad)
+		i = (i + 1) & (NK_LOVE_QUAD_CACHE_SIZE - 1);
+	quad_cache[i] = *entry;
+	quad_cache_count++;
+}
+
+/*
+ * Release the quads that haven't been drawn for NK_LOVE_QUAD_CACHE_TTL
+ * frames, or all of them, and rehash the rest.
+ */
+static void nk_love_quad_cache_sweep(int all)
+{
+	struct nk_love_quad_entry live[NK_LOVE_QUAD_CACHE_SIZE];
+	int live_count = 0;
+	int i;
+	for (i = 0; i < NK_LOVE_QUAD_CACHE_SIZE; ++i) {
+		struct nk_love_quad_entry *entry = &quad_cache[i];
+		if (!entry->quad)
+			continue;
+		if (all || frame_count - entry->frame > NK_LOVE_QUAD_CACHE_TTL)
+			entry->quad->release();
+		else
+			live[live_count++] = *entry;
+	}
+	nk_zero(quad_cache, sizeof(quad_cache));
+	quad_cache_count = 0;
+	for (i = 0; i < live_count; ++i)
+		nk_love_quad_cache_insert(&live[i]);
+}
+
+static love::graphics::Quad *nk_love_get_quad(struct nk_image image)
+{
+	struct nk_love_quad_entry entry;
+	entry.key[0] = image.region[0];
+	entry.key[1] = image.region[1];
+	entry.key[2] = image.region[2];
+	entry.key[3] = image.region[3];
+	entry.key[4] = image.w;
+	entry.key[5] = image.h;
+	nk_hash hash = nk_murmur_hash(entry.key, sizeof(entry.key), 0);
+	int i = hash & (NK_LOVE_QUAD_CACHE_SIZE - 1);
+	while (quad_cache[i].quad) {
+		if (!memcmp(quad_cache[i].key, entry.key, sizeof(entry.key))) {
+			quad_cache[i].frame = frame_count;
+			stats.quad_cache_hits++;
+			return quad_cache[i].quad;
+		}
+		i = (i + 1) & (NK_LOVE_QUAD_CACHE_SIZE - 1);
+	}
+	if (quad_cache_count >= NK_LOVE_QUAD_CACHE_SIZE * 3 / 4)
+		nk_love_quad_cache_sweep(1);
+	love::graphics::Quad::Viewport viewport;
+	viewport.x = image.region[0];
+	viewport.y = image.region[1];
+	viewport.w = image.region[2];
+	viewport.h = image.region[3];
+	entry.quad = lg->newQuad(viewport, image.w, image.h);
+	entry.frame = frame_count;
+	nk_love_quad_cache_insert(&entry);
+	stats.quads_created++;
+	return entry.quad;
+}
+
 static void nk_love_draw_image(int x, int y, unsigned int w, unsigned int h,
 	struct nk_image image, struct nk_color color)
 {
 	nk_love_configureGraphics(-1, color);
-	lua_getfield(L, LUA_REGISTRYINDEX, "nuklear");
-	lua_getfield(L, -1, "image");
-	lua_rawgeti(L, -1, image.handle.id);
-	lua_getfield(L, -5, "newQuad");
-	lua_pushnumber(L, image.region[0]);
-	lua_pushnumber(L, image.region[1]);
-	lua_pushnumber(L, image.region[2]);
-	lua_pushnumber(L, image.region[3]);
-	lua_pushnumber(L, image.w);
-	lua_pushnumber(L, image.h);
-	lua_call(L, 6, 1);
-	lua_replace(L, -3);
-	lua_replace(L, -3);
-	lua_pushnumber(L, x);
-	lua_pushnumber(L, y);
-	lua_pushnumber(L, 0);
-	lua_pushnumber(L, (double) w / image.region[2]);
-	lua_pushnumber(L, (double) h / image.region[3]);
-	lua_call(L, 7, 0);
-	lua_pop(L, 1);
+	love::graphics::Texture *texture = nk_love_get_texture(image.handle.id);
+	love::graphics::Quad *quad = nk_love_get_quad(image);
+	float sx = image.region[2] ? (float) w / image.region[2] : 1;
+	float sy = image.region[3] ? (float) h / image.region[3] : 1;
+	stats.draw_calls++;
+	lg->draw(texture, quad, love::Matrix4(x, y, 0, sx, sy, 0, 0, 0, 0));
 }
 
 static void nk_love_draw_arc(int cx, int cy, unsigned int r,
 	int line_thickness, float a1, float a2, struct nk_color color)
 {
 	nk_love_configureGraphics(line_thickness, color);
-	lua_getfield(L, -1, "arc");
+	love::graphics::Graphics::DrawMode mode;
 	if (line_thickness >= 0) {
-		lua_pushstring(L, "line");
+		mode = love::graphics::Graphics::DrawMode::DRAW_LINE;
 	} else {
-		lua_pushstring(L, "fill");
+		mode = love::graphics::Graphics::DrawMode::DRAW_FILL;
 	}
-	lua_pushnumber(L, cx);
-	lua_pushnumber(L, cy);
-	lua_pushnumber(L, r);
-	lua_pushnumber(L, a1);
-	lua_pushnumber(L, a2);
-	lua_call(L, 6, 0);
-	lua_pop(L, 1);
+	stats.draw_calls++;
+	lg->arc(mode, love::graphics::Graphics::ARC_PIE, cx, cy, r, a1, a2,
+		nk_love_arc_segments(r, a2 - a1));
 }
 
-static void nk_love_clipbard_paste(nk_handle usr, struct nk_text_edit *edit)
+static struct nk_rect nk_love_points_bounds(const struct nk_vec2i *points,
+	int point_count, int line_thickness)
 {
-	(void)usr;
-	lua_getglobal(L, "love");
-	lua_getfield(L, -1, "system");
-	lua_getfield(L, -1, "getClipboardText");
-	lua_call(L, 0, 1);
-	const char *text = lua_tostring(L, -1);
-	if (text) nk_textedit_paste(edit, text, nk_strlen(text));
-	lua_pop(L, 3);
+	int x0 = points[0].x, y0 = points[0].y, x1 = x0, y1 = y0;
+	int i;
+	for (i = 1; i < point_count; ++i) {
+		x0 = NK_MIN(x0, points[i].x);
+		y0 = NK_MIN(y0, points[i].y);
+		x1 = NK_MAX(x1, points[i].x);
+		y1 = NK_MAX(y1, points[i].y);
+	}
+	return nk_rect(x0 - line_thickness, y0 - line_thickness,
+		x1 - x0 + line_thickness * 2, y1 - y0 + line_thickness * 2);
 }
 
-static void nk_love_clipbard_copy(nk_handle usr, const char *text, int len)
+/* Conservative screen area touched by a command, empty for state changes. */
+static struct nk_rect nk_love_command_bounds(const struct nk_command *cmd)
+{
+	switch (cmd->type) {
+	case NK_COMMAND_LINE: {
+		const struct nk_command_line *l = (const struct nk_command_line *)cmd;
+		struct nk_vec2i points[2] = {l->begin, l->end};
+		return nk_love_points_bounds(points, 2, l->line_thickness);
+	}
+	case NK_COMMAND_CURVE: {
+		const struct nk_command_curve *q = (const struct nk_command_curve *)cmd;
+		struct nk_vec2i points[4] = {q->begin, q->ctrl[0], q->ctrl[1], q->end};
+		return nk_love_points_bounds(points, 4, q->line_thickness);
+	}
+	case NK_COMMAND_RECT: {
+		const struct nk_command_rect *r = (const struct nk_command_rect *)cmd;
+		return nk_rect(r->x - r->line_thickness, r->y - r->line_thickness,
+			r->w + r->line_thickness * 2, r->h + r->line_thickness * 2);
+	}
+	case NK_COMMAND_RECT_FILLED: {
+		const struct nk_command_rect_filled *r = (const struct nk_command_rect_filled *)cmd;
+		return nk_rect(r->x, r->y, r->w, r->h);
+	}
+	case NK_COMMAND_RECT_MULTI_COLOR: {
+		const struct nk_command_rect_multi_color *r = (const struct nk_command_rect_multi_color *)cmd;
+		return nk_rect(r->x, r->y, r->w, r->h);
+	}
+	case NK_COMMAND_CIRCLE: {
+		const struct nk_command_circle *c = (const struct nk_command_circle *)cmd;
+		return nk_rect(c->x - c->line_thickness, c->y - c->line_thickness,
+			c->w + c->line_thickness * 2, c->h + c->line_thickness * 2);
+	}
+	case NK_COMMAND_CIRCLE_FILLED: {
+		const struct nk_command_circle_filled *c = (const struct nk_command_circle_filled *)cmd;
+		return nk_rect(c->x, c->y, c->w, c->h);
+	}
+	case NK_COMMAND_ARC: {
+		const struct nk_command_arc *a = (const struct nk_command_arc *)cmd;
+		float r = a->r + a->line_thickness;
+		return nk_rect(a->cx - r, a->cy - r, r * 2, r * 2);
+	}
+	case NK_COMMAND_ARC_FILLED: {
+		const struct nk_command_arc_filled *a = (const struct nk_command_arc_filled *)cmd;
+		return nk_rect(a->cx - a->r, a->cy - a->r, a->r * 2, a->r * 2);
+	}
+	case NK_COMMAND_TRIANGLE: {
+		const struct nk_command_triangle *t = (const struct nk_command_triangle *)cmd;
+		struct nk_vec2i points[3] = {t->a, t->b, t->c};
+		return nk_love_points_bounds(points, 3, t->line_thickness);
+	}
+	case NK_COMMAND_TRIANGLE_FILLED: {
+		const struct nk_command_triangle_filled *t = (const struct nk_command_triangle_filled *)cmd;
+		struct nk_vec2i points[3] = {t->a, t->b, t->c};
+		return nk_love_points_bounds(points, 3, 0);
+	}
+	case NK_COMMAND_POLYGON: {
+		const struct nk_command_polygon *p = (const struct nk_command_polygon *)cmd;
+		return nk_love_points_bounds(p->points, p->point_count, p->line_thickness);
+	}
+	case NK_COMMAND_POLYGON_FILLED: {
+		const struct nk_command_polygon_filled *p = (const struct nk_command_polygon_filled *)cmd;
+		return nk_love_points_bounds(p->points, p->point_count, 0);
+	}
+	case NK_COMMAND_POLYLINE: {
+		const struct nk_command_polyline *p = (const struct nk_command_polyline *)cmd;
+		return nk_love_points_bounds(p->points, p->point_count, p->line_thickness);
+	}
+	case NK_COMMAND_TEXT: {
+		const struct nk_command_text *t = (const struct nk_command_text *)cmd;
+		return nk_rect(t->x, t->y, t->w, t->h);
+	}
+	case NK_COMMAND_IMAGE: {
+		const struct nk_command_image *i = (const struct nk_command_image *)cmd;
+		return nk_rect(i->x, i->y, i->w, i->h);
+	}
+	case NK_COMMAND_CUSTOM: {
+		const struct nk_command_custom *c = (const struct nk_command_custom *)cmd;
+		return nk_rect(c->x, c->y, c->w, c->h);
+	}
+	default:
+		return nk_rect(0, 0, 0, 0);
+	}
+}
+
+static struct nk_rect nk_love_intersect(struct nk_rect a, struct nk_rect b)
+{
+	float x0 = NK_MAX(a.x, b.x), y0 = NK_MAX(a.y, b.y);
+	float x1 = NK_MIN(a.x + a.w, b.x + b.w), y1 = NK_MIN(a.y + a.h, b.y + b.h);
+	return nk_rect(x0, y0, NK_MAX(x1 - x0, 0), NK_MAX(y1 - y0, 0));
+}
+
+/*
+ * A horizontal or vertical line with no thickness still covers a row or
+ * column of pixels, so give degenerate bounds one pixel of extent before
+ * testing them against an area.
+ */
+static struct nk_rect nk_love_drawn_bounds(const struct nk_command *cmd)
+{
+	struct nk_rect bounds = nk_love_command_bounds(cmd);
+	bounds.w = NK_MAX(bounds.w, 1);
+	bounds.h = NK_MAX(bounds.h, 1);
+	return bounds;
+}
+
+/*
+ * Drop primitives that lie entirely outside the current scissor or the
+ * screen before they reach love::graphics.
+ */
+static int nk_love_culled(const struct nk_command *cmd)
+{
+	if (cmd->type == NK_COMMAND_NOP || cmd->type == NK_COMMAND_SCISSOR)
+		return 0;
+	struct nk_rect visible = nk_love_intersect(draw_clip, draw_screen);
+	struct nk_rect bounds = nk_love_intersect(nk_love_drawn_bounds(cmd), visible);
+	if (bounds.w > 0 && bounds.h > 0)
+		return 0;
+	stats.commands_culled++;
+	return 1;
+}
+
+static void nk_love_draw_immediate(const struct nk_command *begin,
+	const struct nk_command *end)
+{
+	const struct nk_command *cmd;
+	for (cmd = begin; cmd != end; cmd = nk__next(&context, cmd))
+	{
+		if (nk_love_culled(cmd))
+			continue;
+		switch (cmd->type) {
+		case NK_COMMAND_NOP: break;
+		case NK_COMMAND_SCISSOR: {
+			const struct nk_command_scissor *s =(const struct nk_command_scissor*)cmd;
+			draw_clip = nk_rect(s->x, s->y, s->w, s->h);
+			nk_love_scissor(s->x, s->y, s->w, s->h);
+		} break;
+		case NK_COMMAND_LINE: {
+			const struct nk_command_line *l = (const struct nk_command_line *)cmd;
+			nk_love_draw_line(l->begin.x, l->begin.y, l->end.x,
+				l->end.y, l->line_thickness, l->color);
+		} break;
+		case NK_COMMAND_RECT: {
+			const struct nk_command_rect *r = (const struct nk_command_rect *)cmd;
+			nk_love_draw_rect(r->x, r->y, r->w, r->h,
+				(unsigned int)r->rounding, r->line_thickness, r->color);
+		} break;
+		case NK_COMMAND_RECT_FILLED: {
+			const struct nk_command_rect_filled *r = (const struct nk_command_rect_filled *)cmd;
+			nk_love_draw_rect(r->x, r->y, r->w, r->h, (unsigned int)r->rounding, -1, r->color);
+		} break;
+		case NK_COMMAND_CIRCLE: {
+			const struct nk_command_circle *c = (const struct nk_command_circle *)cmd;
+			nk_love_draw_circle(c->x, c->y, c->w, c->h, c->line_thickness, c->color);
+		} break;
+		case NK_COMMAND_CIRCLE_FILLED: {
+			const struct nk_command_circle_filled *c = (const struct nk_command_circle_filled *)cmd;
+			nk_love_draw_circle(c->x, c->y, c->w, c->h, -1, c->color);
+		} break;
+		case NK_COMMAND_TRIANGLE: {
+			const struct nk_command_triangle*t = (const struct nk_command_triangle*)cmd;
+			nk_love_draw_triangle(t->a.x, t->a.y, t->b.x, t->b.y,
+				t->c.x, t->c.y, t->line_thickness, t->color);
+		} break;
+		case NK_COMMAND_TRIANGLE_FILLED: {
+			const struct nk_command_triangle_filled *t = (const struct nk_command_triangle_filled *)cmd;
+			nk_love_draw_triangle(t->a.x, t->a.y, t->b.x, t->b.y, t->c.x, t->c.y, -1, t->color);
+		} break;
+		case NK_COMMAND_POLYGON: {
+			const struct nk_command_polygon *p =(const struct nk_command_polygon*)cmd;
+			nk_love_draw_polygon(p->points, p->point_count, p->line_thickness, p->color);
+		} break;
+		case NK_COMMAND_POLYGON_FILLED: {
+			const struct nk_command_polygon_filled *p = (const struct nk_command_polygon_filled*)cmd;
+			nk_love_draw_polygon(p->points, p->point_count, -1, p->color);
+		} break;
+		case NK_COMMAND_POLYLINE: {
+			const struct nk_command_polyline *p = (const struct nk_command_polyline *)cmd;
+			nk_love_draw_polyline(p->points, p->point_count, p->line_thickness, p->color);
+		} break;
+		case NK_COMMAND_TEXT: {
+			const struct nk_command_text *t = (const struct nk_command_text*)cmd;
+			nk_love_draw_text(((struct nk_love_font *) t->font->userdata.ptr)->font, t->background,
+				t->foreground, t->x, t->y, t->w, t->h,
+				t->height, t->length, (const char*)t->string);
+		} break;
+		case NK_COMMAND_CURVE: {
+			const struct nk_command_curve *q = (const struct nk_command_curve *)cmd;
+			nk_love_draw_curve(q->begin, q->ctrl[0], q->ctrl[1], q->end,
+				nk_love_curve_segments(q->begin, q->ctrl[0], q->ctrl[1], q->end),
+				q->line_thickness, q->color);
+		} break;
+		case NK_COMMAND_RECT_MULTI_COLOR: {
+			const struct nk_command_rect_multi_color *r = (const struct nk_command_rect_multi_color *)cmd;
+			nk_love_draw_rect_multi_color(r->x, r->y, r->w, r->h, r->left, r->top, r->right, r->bottom);
+		} break;
+		case NK_COMMAND_IMAGE: {
+			const struct nk_command_image *i = (const struct nk_command_image *)cmd;
+			nk_love_draw_image(i->x, i->y, i->w, i->h, i->img, i->col);
+		} break;
+		case NK_COMMAND_ARC: {
+			const struct nk_command_arc *a = (const struct nk_command_arc *)cmd;
+			nk_love_draw_arc(a->cx, a->cy, a->r, a->line_thickness,
+				a->a[0], a->a[1], a->color);
+		} break;
+		case NK_COMMAND_ARC_FILLED: {
+			const struct nk_command_arc_filled *a = (const struct nk_command_arc_filled *)cmd;
+			nk_love_draw_arc(a->cx, a->cy, a->r, -1, a->a[0], a->a[1], a->color);
+		} break;
+		default: break;
+		}
+	}
+}
+
+static void nk_love_batch_reset(void)
+{
+	nk_buffer_clear(&draw_commands);
+	nk_buffer_clear(&draw_vertices);
+	nk_buffer_clear(&draw_elements);
+	nk_draw_list_init(&draw_list);
+	nk_draw_list_setup(&draw_list, &convert_config, &draw_commands,
+		&draw_vertices, &draw_elements, convert_config.line_AA,
+		convert_config.shape_AA);
+	nk_draw_list_add_clip(&draw_list, draw_clip);
+}
+
+static void nk_love_batch_reserve(int vertex_count)
+{
+	if (draw_mesh && vertex_count <= draw_mesh_capacity)
+		return;
+	int capacity = NK_MAX(draw_mesh_capacity, 1024);
+	while (capacity < vertex_count)
+		capacity *= 2;
+	if (draw_mesh)
+		draw_mesh->release();
+	draw_mesh = lg->newMesh(love::graphics::Mesh::getDefaultVertexFormat(),
+		capacity, love::graphics::PRIMITIVE_TRIANGLES,
+		love::graphics::vertex::USAGE_STREAM);
+	draw_mesh_capacity = capacity;
+}
+
+/*
+ * Upload everything tessellated since the last flush into the streaming
+ * mesh and issue one draw per texture/scissor run.
+ */
+static void nk_love_batch_flush(void)
+{
+	NK_LOVE_ZONE_BEGIN(flush_start);
+	if (draw_list.element_count > 0) {
+		nk_love_batch_reserve(draw_list.vertex_count);
+		draw_mesh->setVertices(0, nk_buffer_memory_const(&draw_vertices),
+			draw_list.vertex_count * sizeof(struct nk_love_vertex));
+		draw_mesh->setVertexMap(love::graphics::vertex::INDEX_UINT32,
+			nk_buffer_memory_const(&draw_elements),
+			draw_list.element_count * sizeof(nk_draw_index));
+		nk_love_set_color(nk_rgba(255, 255, 255, 255));
+		const struct nk_draw_command *cmd;
+		int offset = 0;
+		nk_draw_list_foreach(cmd, &draw_list, &draw_commands)
+		{
+			if (!cmd->elem_count)
+				continue;
+			nk_love_scissor(cmd->clip_rect.x, cmd->clip_rect.y,
+				cmd->clip_rect.w, cmd->clip_rect.h);
+			if (cmd->texture.id)
+				draw_mesh->setTexture(nk_love_get_texture(cmd->texture.id));
+			else
+				draw_mesh->setTexture();
+			draw_mesh->setDrawRange(offset, cmd->elem_count);
+			stats.draw_calls++;
+			draw_mesh->draw(lg, love::Matrix4());
+			offset += cmd->elem_count;
+		}
+	}
+	nk_love_batch_reset();
+	NK_LOVE_ZONE_END("batch flush", flush_start);
+}
+
+static void nk_love_draw_batched(const struct nk_command *begin,
+	const struct nk_command *end)
+{
+	const struct nk_command *cmd;
+	nk_love_batch_reset();
+	for (cmd = begin; cmd != end; cmd = nk__next(&context, cmd))
+	{
+		if (nk_love_culled(cmd))
+			continue;
+		switch (cmd->type) {
+		case NK_COMMAND_NOP: break;
+		case NK_COMMAND_SCISSOR: {
+			const struct nk_command_scissor *s = (const struct nk_command_scissor*)cmd;
+			draw_clip = nk_rect(s->x, s->y, s->w, s->h);
+			nk_draw_list_add_clip(&draw_list, draw_clip);
+		} break;
+		case NK_COMMAND_LINE: {
+			const struct nk_command_line *l = (const struct nk_command_line*)cmd;
+			nk_draw_list_stroke_line(&draw_list, nk_vec2(l->begin.x, l->begin.y),
+				nk_vec2(l->end.x, l->end.y), l->color, l->line_thickness);
+		} break;
+		case NK_COMMAND_CURVE: {
+			const struct nk_command_curve *q = (const struct nk_command_curve*)cmd;
+			nk_draw_list_stroke_curve(&draw_list, nk_vec2(q->begin.x, q->begin.y),
+				nk_vec2(q->ctrl[0].x, q->ctrl[0].y), nk_vec2(q->ctrl[1].x, q->ctrl[1].y),
+				nk_vec2(q->end.x, q->end.y), q->color,
+				nk_love_curve_segments(q->begin, q->ctrl[0], q->ctrl[1], q->end),
+				q->line_thickness);
+		} break;
+		case NK_COMMAND_RECT: {
+			const struct nk_command_rect *r = (const struct nk_command_rect*)cmd;
+			nk_draw_list_stroke_rect(&draw_list, nk_rect(r->x, r->y, r->w, r->h),
+				r->color, (float)r->rounding, r->line_thickness);
+		} break;
+		case NK_COMMAND_RECT_FILLED: {
+			const struct nk_command_rect_filled *r = (const struct nk_command_rect_filled*)cmd;
+			nk_draw_list_fill_rect(&draw_list, nk_rect(r->x, r->y, r->w, r->h),
+				r->color, (float)r->rounding);
+		} break;
+		case NK_COMMAND_RECT_MULTI_COLOR: {
+			/* nk.rectMultiColor passes the bottom corners left to right */
+			const struct nk_command_rect_multi_color *r = (const struct nk_command_rect_multi_color*)cmd;
+			nk_draw_list_fill_rect_multi_color(&draw_list, nk_rect(r->x, r->y, r->w, r->h),
+				r->left, r->top, r->bottom, r->right);
+		} break;
+		case NK_COMMAND_CIRCLE: {
+			const struct nk_command_circle *c = (const struct nk_command_circle*)cmd;
+			nk_draw_list_stroke_circle(&draw_list, nk_vec2((float)c->x + (float)c->w/2,
+				(float)c->y + (float)c->h/2), (float)c->w/2, c->color,
+				nk_love_circle_segments((float)c->w/2), c->line_thickness);
+		} break;
+		case NK_COMMAND_CIRCLE_FILLED: {
+			const struct nk_command_circle_filled *c = (const struct nk_command_circle_filled*)cmd;
+			nk_draw_list_fill_circle(&draw_list, nk_vec2((float)c->x + (float)c->w/2,
+				(float)c->y + (float)c->h/2), (float)c->w/2, c->color,
+				nk_love_circle_segments((float)c->w/2));
+		} break;
+		case NK_COMMAND_ARC: {
+			const struct nk_command_arc *c = (const struct nk_command_arc*)cmd;
+			nk_draw_list_path_line_to(&draw_list, nk_vec2(c->cx, c->cy));
+			nk_draw_list_path_arc_to(&draw_list, nk_vec2(c->cx, c->cy), c->r,
+				c->a[0], c->a[1], nk_love_arc_segments(c->r, c->a[1] - c->a[0]));
+			nk_draw_list_path_stroke(&draw_list, c->color, NK_STROKE_CLOSED, c->line_thickness);
+		} break;
+		case NK_COMMAND_ARC_FILLED: {
+			const struct nk_command_arc_filled *c = (const struct nk_command_arc_filled*)cmd;
+			nk_draw_list_path_line_to(&draw_list, nk_vec2(c->cx, c->cy));
+			nk_draw_list_path_arc_to(&draw_list, nk_vec2(c->cx, c->cy), c->r,
+				c->a[0], c->a[1], nk_love_arc_segments(c->r, c->a[1] - c->a[0]));
+			nk_draw_list_path_fill(&draw_list, c->color);
+		} break;
+		case NK_COMMAND_TRIANGLE: {
+			const struct nk_command_triangle *t = (const struct nk_command_triangle*)cmd;
+			nk_draw_list_stroke_triangle(&draw_list, nk_vec2(t->a.x, t->a.y),
+				nk_vec2(t->b.x, t->b.y), nk_vec2(t->c.x, t->c.y), t->color,
+				t->line_thickness);
+		} break;
+		case NK_COMMAND_TRIANGLE_FILLED: {
+			const struct nk_command_triangle_filled *t = (const struct nk_command_triangle_filled*)cmd;
+			nk_draw_list_fill_triangle(&draw_list, nk_vec2(t->a.x, t->a.y),
+				nk_vec2(t->b.x, t->b.y), nk_vec2(t->c.x, t->c.y), t->color);
+		} break;
+		case NK_COMMAND_POLYGON: {
+			const struct nk_command_polygon *p = (const struct nk_command_polygon*)cmd;
+			int i;
+			for (i = 0; i < p->point_count; ++i)
+				nk_draw_list_path_line_to(&draw_list, nk_vec2(p->points[i].x, p->points[i].y));
+			nk_draw_list_path_stroke(&draw_list, p->color, NK_STROKE_CLOSED, p->line_thickness);
+		} break;
+		case NK_COMMAND_POLYGON_FILLED: {
+			const struct nk_command_polygon_filled *p = (const struct nk_command_polygon_filled*)cmd;
+			int i;
+			for (i = 0; i < p->point_count; ++i)
+				nk_draw_list_path_line_to(&draw_list, nk_vec2(p->points[i].x, p->points[i].y));
+			nk_draw_list_path_fill(&draw_list, p->color);
+		} break;
+		case NK_COMMAND_POLYLINE: {
+			const struct nk_command_polyline *p = (const struct nk_command_polyline*)cmd;
+			int i;
+			for (i = 0; i < p->point_count; ++i)
+				nk_draw_list_path_line_to(&draw_list, nk_vec2(p->points[i].x, p->points[i].y));
+			nk_draw_list_path_stroke(&draw_list, p->color, NK_STROKE_OPEN, p->line_thickness);
+		} break;
+		case NK_COMMAND_TEXT: {
+			/* LOVE fonts don't expose a glyph atlas, so text ends the batch */
+			const struct nk_command_text *t = (const struct nk_command_text*)cmd;
+			nk_love_batch_flush();
+			nk_love_scissor(draw_clip.x, draw_clip.y, draw_clip.w, draw_clip.h);
+			nk_love_draw_text(((struct nk_love_font *) t->font->userdata.ptr)->font, t->background,
+				t->foreground, t->x, t->y, t->w, t->h,
+				t->height, t->length, (const char*)t->string);
+		} break;
+		case NK_COMMAND_IMAGE: {
+			const struct nk_command_image *i = (const struct nk_command_image*)cmd;
+			nk_draw_list_add_image(&draw_list, i->img, nk_rect(i->x, i->y, i->w, i->h), i->col);
+		} break;
+		default: break;
+		}
+	}
+	nk_love_batch_flush();
+}
+
+static void nk_love_clipbard_paste(nk_handle usr, struct nk_text_edit *edit)
+{
+	(void)usr;
+	lua_getglobal(L, "love");
+	lua_getfield(L, -1, "system");
+	lua_getfield(L, -1, "getClipboardText");
+	lua_call(L, 0, 1);
+	const char *text = lua_tostring(L, -1);
+	if (text) nk_textedit_paste(edit, text, nk_strlen(text));
+	lua_pop(L, 3);
+}
+
+static nk_size nk_love_clipboard_length(void)
+{
+	size_t len = 0;
+	lua_getglobal(L, "love");
+	lua_getfield(L, -1, "system");
+	lua_getfield(L, -1, "getClipboardText");
+	lua_call(L, 0, 1);
+	if (lua_isstring(L, -1))
+		lua_tolstring(L, -1, &len);
+	lua_pop(L, 3);
+	return len;
+}
+
+static void nk_love_clipbard_copy(nk_handle usr, const char *text, int len)
 {
 	(void)usr;
 	char *str = 0;
@@ -373,6 +1639,62 @@ static void nk_love_clipbard_copy(nk_handle usr, const char *text, int len)
 	lua_pop(L, 2);
 }
 
+static void nk_love_input_write(enum nk_love_input_type type, const nk_int *values, int count)
+{
+	if (!input_file)
+		return;
+	if (fputc(type, input_file) == EOF
+		|| fwrite(values, sizeof(nk_int), count, input_file) != (size_t) count) {
+		/* stop recording, a log with a hole in it cannot be replayed */
+		fclose(input_file);
+		input_file = NULL;
+		luaL_error(L, "could not write the input recording");
+	}
+}
+
+static void nk_love_input_frame(float dt)
+{
+	nk_int value;
+	memcpy(&value, &dt, sizeof(value));
+	nk_love_input_write(NK_LOVE_INPUT_FRAME, &value, 1);
+}
+
+static void nk_love_input_key(enum nk_keys key, int down)
+{
+	nk_int values[2] = {key, down};
+	nk_love_input_write(NK_LOVE_INPUT_KEY, values, 2);
+	nk_input_key(&context, key, down);
+}
+
+static void nk_love_input_button(enum nk_buttons button, int x, int y, int down)
+{
+	nk_int values[4] = {button, x, y, down};
+	nk_love_input_write(NK_LOVE_INPUT_BUTTON, values, 4);
+	nk_input_button(&context, button, x, y, down);
+}
+
+static void nk_love_input_motion(int x, int y)
+{
+	nk_int values[2] = {x, y};
+	nk_love_input_write(NK_LOVE_INPUT_MOTION, values, 2);
+	nk_input_motion(&context, x, y);
+}
+
+static void nk_love_input_unicode(nk_rune rune)
+{
+	nk_int value = (nk_int) rune;
+	nk_love_input_write(NK_LOVE_INPUT_UNICODE, &value, 1);
+	nk_input_unicode(&context, rune);
+}
+
+static void nk_love_input_scroll(float y)
+{
+	nk_int value;
+	memcpy(&value, &y, sizeof(value));
+	nk_love_input_write(NK_LOVE_INPUT_SCROLL, &value, 1);
+	nk_input_scroll(&context, y);
+}
+
 static int nk_love_is_active(struct nk_context *ctx)
 {
 	struct nk_window *iter;
@@ -411,51 +1733,51 @@ static int nk_love_keyevent(const char *key, const char *scancode,
 	lua_pop(L, 3);
 
 	if (!strcmp(key, "rshift") || !strcmp(key, "lshift"))
-		nk_input_key(&context, NK_KEY_SHIFT, down);
+		nk_love_input_key(NK_KEY_SHIFT, down);
 	else if (!strcmp(key, "delete"))
-		nk_input_key(&context, NK_KEY_DEL, down);
+		nk_love_input_key(NK_KEY_DEL, down);
 	else if (!strcmp(key, "return"))
-		nk_input_key(&context, NK_KEY_ENTER, down);
+		nk_love_input_key(NK_KEY_ENTER, down);
 	else if (!strcmp(key, "tab"))
-		nk_input_key(&context, NK_KEY_TAB, down);
+		nk_love_input_key(NK_KEY_TAB, down);
 	else if (!strcmp(key, "backspace"))
-		nk_input_key(&context, NK_KEY_BACKSPACE, down);
+		nk_love_input_key(NK_KEY_BACKSPACE, down);
 	else if (!strcmp(key, "home")) {
-		nk_input_key(&context, NK_KEY_TEXT_LINE_START, down);
+		nk_love_input_key(NK_KEY_TEXT_LINE_START, down);
 	} else if (!strcmp(key, "end")) {
-		nk_input_key(&context, NK_KEY_TEXT_LINE_END, down);
+		nk_love_input_key(NK_KEY_TEXT_LINE_END, down);
 	} else if (!strcmp(key, "pagedown")) {
-		nk_input_key(&context, NK_KEY_SCROLL_DOWN, down);
+		nk_love_input_key(NK_KEY_SCROLL_DOWN, down);
 	} else if (!strcmp(key, "pageup")) {
-		nk_input_key(&context, NK_KEY_SCROLL_UP, down);
+		nk_love_input_key(NK_KEY_SCROLL_UP, down);
 	} else if (!strcmp(key, "z"))
-		nk_input_key(&context, NK_KEY_TEXT_UNDO, down && lctrl);
+		nk_love_input_key(NK_KEY_TEXT_UNDO, down && lctrl);
 	else if (!strcmp(key, "r"))
-		nk_input_key(&context, NK_KEY_TEXT_REDO, down && lctrl);
+		nk_love_input_key(NK_KEY_TEXT_REDO, down && lctrl);
 	else if (!strcmp(key, "c"))
-		nk_input_key(&context, NK_KEY_COPY, down && lctrl);
+		nk_love_input_key(NK_KEY_COPY, down && lctrl);
 	else if (!strcmp(key, "v"))
-		nk_input_key(&context, NK_KEY_PASTE, down && lctrl);
+		nk_love_input_key(NK_KEY_PASTE, down && lctrl);
 	else if (!strcmp(key, "x"))
-		nk_input_key(&context, NK_KEY_CUT, down && lctrl);
+		nk_love_input_key(NK_KEY_CUT, down && lctrl);
 	else if (!strcmp(key, "b"))
-		nk_input_key(&context, NK_KEY_TEXT_LINE_START, down && lctrl);
+		nk_love_input_key(NK_KEY_TEXT_LINE_START, down && lctrl);
 	else if (!strcmp(key, "e"))
-		nk_input_key(&context, NK_KEY_TEXT_LINE_END, down && lctrl);
+		nk_love_input_key(NK_KEY_TEXT_LINE_END, down && lctrl);
 	else if (!strcmp(key, "left")) {
 		if (lctrl)
-			nk_input_key(&context, NK_KEY_TEXT_WORD_LEFT, down);
+			nk_love_input_key(NK_KEY_TEXT_WORD_LEFT, down);
 		else
-			nk_input_key(&context, NK_KEY_LEFT, down);
+			nk_love_input_key(NK_KEY_LEFT, down);
 	} else if (!strcmp(key, "right")) {
 		if (lctrl)
-			nk_input_key(&context, NK_KEY_TEXT_WORD_RIGHT, down);
+			nk_love_input_key(NK_KEY_TEXT_WORD_RIGHT, down);
 		else
-			nk_input_key(&context, NK_KEY_RIGHT, down);
+			nk_love_input_key(NK_KEY_RIGHT, down);
 	} else if (!strcmp(key, "up"))
-		nk_input_key(&context, NK_KEY_UP, down);
+		nk_love_input_key(NK_KEY_UP, down);
 	else if (!strcmp(key, "down"))
-		nk_input_key(&context, NK_KEY_DOWN, down);
+		nk_love_input_key(NK_KEY_DOWN, down);
 	else
 		return 0;
 	return nk_love_is_active(&context);
@@ -464,11 +1786,11 @@ static int nk_love_keyevent(const char *key, const char *scancode,
 static int nk_love_clickevent(int x, int y, int button, int istouch, int down)
 {
 	if (button == 1)
-		nk_input_button(&context, NK_BUTTON_LEFT, x, y, down);
+		nk_love_input_button(NK_BUTTON_LEFT, x, y, down);
 	else if (button == 3)
-		nk_input_button(&context, NK_BUTTON_MIDDLE, x, y, down);
+		nk_love_input_button(NK_BUTTON_MIDDLE, x, y, down);
 	else if (button == 2)
-		nk_input_button(&context, NK_BUTTON_RIGHT, x, y, down);
+		nk_love_input_button(NK_BUTTON_RIGHT, x, y, down);
 	else
 		return 0;
 	return nk_window_is_any_hovered(&context);
@@ -476,7 +1798,7 @@ static int nk_love_clickevent(int x, int y, int button, int istouch, int down)
 
 static int nk_love_mousemoved_event(int x, int y, int dx, int dy, int istouch)
 {
-	nk_input_motion(&context, x, y);
+	nk_love_input_motion(x, y);
 	return nk_window_is_any_hovered(&context);
 }
 
@@ -484,13 +1806,13 @@ static int nk_love_textinput_event(const char *text)
 {
 	nk_rune rune;
 	nk_utf_decode(text, &rune, strlen(text));
-	nk_input_unicode(&context, rune);
+	nk_love_input_unicode(rune);
 	return nk_love_is_active(&context);
 }
 
 static int nk_love_wheelmoved_event(int x, int y)
 {
-	nk_input_scroll(&context,(float)y);
+	nk_love_input_scroll((float)y);
 	return nk_window_is_any_hovered(&context);
 }
 
@@ -522,26 +1844,6 @@ static int nk_love_is_type(int index, const char *type)
 	return 0;
 }
 
-static void nk_love_checkFont(int index, struct nk_user_font *font)
-{
-	if (index < 0)
-		index += lua_gettop(L) + 1;
-	if (!nk_love_is_type(index, "Font"))
-		luaL_typerror(L, index, "Font");
-	lua_getfield(L, LUA_REGISTRYINDEX, "nuklear");
-	lua_getfield(L, -1, "font");
-	lua_pushvalue(L, index);
-	int ref = luaL_ref(L, -2);
-	lua_getfield(L, index, "getHeight");
-	lua_pushvalue(L, index);
-	lua_call(L, 1, 1);
-	float height = lua_tonumber(L, -1);
-	font->userdata = nk_handle_id(ref);
-	font->height = height;
-	font->width = nk_love_get_text_width;
-	lua_pop(L, 3);
-}
-
 static void nk_love_checkImage(int index, struct nk_image *image)
 {
 	if (index < 0)
@@ -883,35 +2185,374 @@ static void *nk_love_malloc(size_t size) {
 	return mem;
 }
 
-static int nk_love_init(lua_State *luaState)
+static struct nk_love_font *nk_love_acquire_font(love::graphics::Font *font)
 {
-	lg = love::Module::getInstance<love::graphics::Graphics>(love::Module::M_GRAPHICS);
-	L = luaState;
-	nk_love_assert_argc(lua_gettop(L) == 0);
-	lua_newtable(L);
-	lua_pushvalue(L, -1);
-	lua_setfield(L, LUA_REGISTRYINDEX, "nuklear");
-	lua_newtable(L);
-	lua_setfield(L, -2, "font");
-	lua_newtable(L);
-	lua_setfield(L, -2, "image");
-	lua_newtable(L);
-	lua_setfield(L, -2, "stack");
-	fonts = (nk_user_font*) nk_love_malloc(sizeof(struct nk_user_font) * NK_LOVE_MAX_FONTS);
-	lua_getglobal(L, "love");
-	nk_love_assert(lua_istable(L, -1), "LOVE-Nuklear requires LOVE environment");
-	lua_getfield(L, -1, "graphics");
-	lua_getfield(L, -1, "getFont");
-	lua_call(L, 0, 1);
-	nk_love_checkFont(-1, &fonts[0]);
-	nk_init_default(&context, &fonts[0]);
+	struct nk_love_font *record;
+	int i;
+	for (record = font_records; record; record = record->next) {
+		if (record->font == font) {
+			record->refs++;
+			record->frame = frame_count;
+			return record;
+		}
+	}
+	record = (struct nk_love_font *) nk_love_malloc(sizeof(struct nk_love_font));
+	nk_zero(record, sizeof(struct nk_love_font));
+	for (i = 0; i < 256; ++i)
+		record->latin1[i] = -1;
+	if (font)
+		font->retain();
+	record->font = font;
+	record->refs = 1;
+	record->frame = frame_count;
+	record->next = font_records;
+	font_records = record;
+	return record;
+}
+
+static void nk_love_release_font(struct nk_love_font *record)
+{
+	record->refs--;
+	record->frame = frame_count;
+}
+
+static void nk_love_font_sweep(int all)
+{
+	struct nk_love_font **link = &font_records;
+	while (*link) {
+		struct nk_love_font *record = *link;
+		if (record->refs <= 0 && (all || frame_count - record->frame >= NK_LOVE_FONT_TTL)) {
+			*link = record->next;
+			font_width_hits += record->width_hits;
+			font_width_misses += record->width_misses;
+			if (record->font)
+				record->font->release();
+			free(record);
+		} else {
+			link = &record->next;
+		}
+	}
+}
+
+static void nk_love_set_user_font(struct nk_user_font *font,
+	struct nk_love_font *record)
+{
+	record->refs++;
+	font->userdata = nk_handle_ptr(record);
+	font->height = record->font ? record->font->getHeight() : NK_LOVE_SYNTHETIC_FONT_HEIGHT;
+	font->width = nk_love_get_text_width;
+}
+
+static void nk_love_release_user_font(struct nk_user_font *font)
+{
+	struct nk_love_font *record = (struct nk_love_font *) font->userdata.ptr;
+	if (record)
+		nk_love_release_font(record);
+	font->userdata = nk_handle_ptr(0);
+}
+
+/*
+ * Font slots handed to nuklear. Commands and the style keep pointers to
+ * them until the next frame, so slots live in fixed-size chunks that are
+ * chained on as needed and never move.
+ */
+struct nk_love_font_chunk {
+	struct nk_love_font_chunk *next;
+	struct nk_user_font fonts[NK_LOVE_FONT_CHUNK_SIZE];
+};
+
+static struct nk_love_font_chunk *font_chunks;
+
+static struct nk_user_font *nk_love_font_slot(int index)
+{
+	nk_love_assert(index < max_fonts, "%s: too many fonts in one frame");
+	struct nk_love_font_chunk **chunk = &font_chunks;
+	for (;;) {
+		if (!*chunk) {
+			*chunk = (struct nk_love_font_chunk *) nk_love_malloc(sizeof(struct nk_love_font_chunk));
+			(*chunk)->next = NULL;
+		}
+		if (index < NK_LOVE_FONT_CHUNK_SIZE)
+			return &(*chunk)->fonts[index];
+		index -= NK_LOVE_FONT_CHUNK_SIZE;
+		chunk = &(*chunk)->next;
+	}
+}
+
+static void nk_love_release_fonts(void)
+{
+	int i;
+	for (i = 0; i < font_count; ++i)
+		nk_love_release_user_font(nk_love_font_slot(i));
+	font_count = 0;
+}
+
+/* Grow an array to hold at least count elements, at least doubling it. */
+static void *nk_love_reserve(void *array, nk_size *capacity, nk_size count, nk_size size)
+{
+	if (count <= *capacity)
+		return array;
+	nk_size new_capacity = NK_MAX(*capacity * 2, count);
+	void *mem = realloc(array, new_capacity * size);
+	nk_love_assert_alloc(mem);
+	*capacity = new_capacity;
+	return mem;
+}
+
+static void nk_love_checkFont(int index, struct nk_user_font *font)
+{
+	if (index < 0)
+		index += lua_gettop(L) + 1;
+	love::graphics::Font *love_font = luax_checktype<love::graphics::Font>(L, index);
+	struct nk_love_font *record = nk_love_acquire_font(love_font);
+	nk_love_set_user_font(font, record);
+	nk_love_release_font(record);
+}
+
+static enum nk_love_renderer nk_love_checkrenderer(int index)
+{
+	if (index < 0)
+		index += lua_gettop(L) + 1;
+	nk_love_assert(lua_isstring(L, index), "%s: renderer must be a string");
+	const char *type = lua_tostring(L, index);
+	if (!strcmp(type, "immediate")) {
+		return NK_LOVE_IMMEDIATE;
+	} else if (!strcmp(type, "batched")) {
+		return NK_LOVE_BATCHED;
+	} else {
+		const char *msg = lua_pushfstring(L, "%%s: unrecognized renderer '%s'", type);
+		nk_love_assert(0, msg);
+	}
+	return NK_LOVE_IMMEDIATE;
+}
+
+static enum nk_love_cache nk_love_checkcache(int index)
+{
+	if (index < 0)
+		index += lua_gettop(L) + 1;
+	nk_love_assert(lua_isstring(L, index), "%s: cache must be a string");
+	const char *type = lua_tostring(L, index);
+	if (!strcmp(type, "none")) {
+		return NK_LOVE_CACHE_NONE;
+	} else if (!strcmp(type, "frame")) {
+		return NK_LOVE_CACHE_FRAME;
+	} else if (!strcmp(type, "window")) {
+		return NK_LOVE_CACHE_WINDOW;
+	} else {
+		const char *msg = lua_pushfstring(L, "%%s: unrecognized cache mode '%s'", type);
+		nk_love_assert(0, msg);
+	}
+	return NK_LOVE_CACHE_NONE;
+}
+
+static enum nk_love_backend_type nk_love_checkbackend(int index)
+{
+	if (index < 0)
+		index += lua_gettop(L) + 1;
+	nk_love_assert(lua_isstring(L, index), "%s: backend must be a string");
+	const char *type = lua_tostring(L, index);
+	if (!strcmp(type, "graphics")) {
+		return NK_LOVE_BACKEND_GRAPHICS;
+	} else if (!strcmp(type, "record")) {
+		return NK_LOVE_BACKEND_RECORD;
+	} else {
+		const char *msg = lua_pushfstring(L, "%%s: unrecognized backend '%s'", type);
+		nk_love_assert(0, msg);
+	}
+	return NK_LOVE_BACKEND_GRAPHICS;
+}
+
+static enum nk_love_allocator_type nk_love_checkallocator(int index)
+{
+	if (index < 0)
+		index += lua_gettop(L) + 1;
+	nk_love_assert(lua_isstring(L, index), "%s: allocator must be a string");
+	const char *type = lua_tostring(L, index);
+	if (!strcmp(type, "default")) {
+		return NK_LOVE_ALLOCATOR_DEFAULT;
+	} else if (!strcmp(type, "pool")) {
+		return NK_LOVE_ALLOCATOR_POOL;
+	} else {
+		const char *msg = lua_pushfstring(L, "%%s: unrecognized allocator '%s'", type);
+		nk_love_assert(0, msg);
+	}
+	return NK_LOVE_ALLOCATOR_DEFAULT;
+}
+
+/* Zero keeps the adaptive count, anything else must be a usable count. */
+static unsigned int nk_love_checksegments(const char *name, int *vertex_output)
+{
+	unsigned int segments = 0;
+	lua_getfield(L, 1, name);
+	if (!lua_isnil(L, -1)) {
+		const char *msg = lua_pushfstring(L, "%%s: %s must be 0 or an integer from %d to %d",
+			name, NK_LOVE_MIN_SEGMENTS, NK_LOVE_MAX_SEGMENTS);
+		lua_Number value = lua_tonumber(L, -2);
+		nk_love_assert(lua_isnumber(L, -2) && value == floor(value) && (value == 0
+			|| (value >= NK_LOVE_MIN_SEGMENTS && value <= NK_LOVE_MAX_SEGMENTS)), msg);
+		lua_pop(L, 1);
+		segments = (unsigned int) lua_tointeger(L, -1);
+		*vertex_output = 1;
+	}
+	lua_pop(L, 1);
+	return segments;
+}
+
+static nk_size nk_love_checklimit(const char *name, nk_size fallback, nk_size max)
+{
+	nk_size limit = fallback;
+	lua_getfield(L, 1, name);
+	if (!lua_isnil(L, -1)) {
+		lua_Number value = lua_tonumber(L, -1);
+		const char *msg = lua_pushfstring(L, "%%s: %s must be a positive integer", name);
+		nk_love_assert(lua_isnumber(L, -2) && value == floor(value) && value >= 1, msg);
+		lua_pop(L, 1);
+		/* max + 1 is exact where max itself may round up */
+		msg = lua_pushfstring(L, "%%s: %s is too large", name);
+		nk_love_assert(value < (lua_Number) max + 1, msg);
+		lua_pop(L, 1);
+		limit = (nk_size) value;
+	}
+	lua_pop(L, 1);
+	return limit;
+}
+
+static int nk_love_init(lua_State *luaState)
+{
+	lg = love::Module::getInstance<love::graphics::Graphics>(love::Module::M_GRAPHICS);
+	L = luaState;
+	int argc = lua_gettop(L);
+	nk_love_assert_argc(argc <= 1);
+	renderer = NK_LOVE_IMMEDIATE;
+	frame_cache = NK_LOVE_CACHE_NONE;
+	backend_type = NK_LOVE_BACKEND_GRAPHICS;
+	allocator_type = NK_LOVE_ALLOCATOR_DEFAULT;
+	edit_buffer_len = NK_LOVE_EDIT_BUFFER_LEN;
+	max_fonts = NK_LOVE_MAX_FONTS;
+	combobox_max_items = NK_LOVE_COMBOBOX_MAX_ITEMS;
+	record_limit = NK_LOVE_RECORD_LIMIT;
+	const char *record_path = NULL;
+	nk_size memory = 0;
+	nk_zero_struct(convert_config);
+	convert_config.vertex_layout = vertex_layout;
+	convert_config.vertex_size = sizeof(struct nk_love_vertex);
+	convert_config.vertex_alignment = NK_ALIGNOF(struct nk_love_vertex);
+	convert_config.null.texture = nk_handle_id(0);
+	convert_config.null.uv = nk_vec2(0, 0);
+	convert_config.global_alpha = 1.0f;
+	convert_config.line_AA = NK_ANTI_ALIASING_OFF;
+	convert_config.shape_AA = NK_ANTI_ALIASING_OFF;
+	if (argc == 1 && !lua_isnil(L, 1)) {
+		if (!lua_istable(L, 1))
+			luaL_typerror(L, 1, "table");
+		/* vertex output settings select the batched renderer unless told otherwise */
+		int vertex_output = 0;
+		lua_getfield(L, 1, "antialiasing");
+		if (!lua_isnil(L, -1)) {
+			nk_love_assert(lua_isboolean(L, -1), "%s: antialiasing must be a boolean");
+			if (lua_toboolean(L, -1)) {
+				convert_config.line_AA = NK_ANTI_ALIASING_ON;
+				convert_config.shape_AA = NK_ANTI_ALIASING_ON;
+			}
+			vertex_output = 1;
+		}
+		lua_pop(L, 1);
+		convert_config.circle_segment_count = nk_love_checksegments("circle segments", &vertex_output);
+		convert_config.arc_segment_count = nk_love_checksegments("arc segments", &vertex_output);
+		convert_config.curve_segment_count = nk_love_checksegments("curve segments", &vertex_output);
+		lua_getfield(L, 1, "renderer");
+		if (!lua_isnil(L, -1))
+			renderer = nk_love_checkrenderer(-1);
+		else if (vertex_output)
+			renderer = NK_LOVE_BATCHED;
+		lua_pop(L, 1);
+		nk_love_assert(renderer == NK_LOVE_BATCHED || convert_config.line_AA == NK_ANTI_ALIASING_OFF,
+			"%s: antialiasing requires the batched renderer");
+		lua_getfield(L, 1, "cache");
+		if (!lua_isnil(L, -1))
+			frame_cache = nk_love_checkcache(-1);
+		lua_pop(L, 1);
+		lua_getfield(L, 1, "backend");
+		if (!lua_isnil(L, -1))
+			backend_type = nk_love_checkbackend(-1);
+		lua_pop(L, 1);
+		/* nk_edit_string takes the buffer size as an int */
+		edit_buffer_len = nk_love_checklimit("edit buffer size", NK_LOVE_EDIT_BUFFER_LEN, INT_MAX);
+		max_fonts = (int) nk_love_checklimit("max fonts", NK_LOVE_MAX_FONTS, INT_MAX);
+		combobox_max_items = (int) nk_love_checklimit("max combobox items", NK_LOVE_COMBOBOX_MAX_ITEMS, INT_MAX);
+		record_limit = nk_love_checklimit("record limit", NK_LOVE_RECORD_LIMIT, (nk_size) -1);
+		lua_getfield(L, 1, "allocator");
+		if (!lua_isnil(L, -1))
+			allocator_type = nk_love_checkallocator(-1);
+		lua_pop(L, 1);
+		lua_getfield(L, 1, "memory");
+		if (!lua_isnil(L, -1)) {
+			nk_love_assert(lua_isnumber(L, -1) && lua_tonumber(L, -1) > 0,
+				"%s: memory must be a positive number of bytes");
+			memory = (nk_size) lua_tonumber(L, -1);
+		}
+		lua_pop(L, 1);
+		lua_getfield(L, 1, "record path");
+		if (!lua_isnil(L, -1)) {
+			nk_love_assert(lua_isstring(L, -1), "%s: record path must be a string");
+			nk_love_assert(backend_type == NK_LOVE_BACKEND_RECORD, "%s: record path requires the record backend");
+			record_path = lua_tostring(L, -1);
+		}
+		/* keep the path on the stack until the file is open */
+	}
+	nk_love_assert(backend_type != NK_LOVE_BACKEND_GRAPHICS || lg != NULL,
+		"%s: the graphics backend requires love.graphics");
+	if (backend_type == NK_LOVE_BACKEND_RECORD) {
+		nk_love_buffer_init(&record_buffer);
+		if (record_path) {
+			record_file = fopen(record_path, "wb");
+			const char *msg = lua_pushfstring(L, "%%s: could not open '%s' for writing", record_path);
+			nk_love_assert(record_file != NULL, msg);
+			lua_pop(L, 1);
+		}
+	}
+	frame_hash = 0;
+	frame_changed = 1;
+	frame_hash_requested = 0;
+	frame_canvas_hash = 0;
+	lua_newtable(L);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, LUA_REGISTRYINDEX, "nuklear");
+	lua_newtable(L);
+	lua_setfield(L, -2, "image");
+	lua_newtable(L);
+	lua_setfield(L, -2, "stack");
+	struct nk_user_font *font = nk_love_font_slot(0);
+	lua_getglobal(L, "love");
+	nk_love_assert(lua_istable(L, -1), "LOVE-Nuklear requires LOVE environment");
+	if (lg) {
+		lua_getfield(L, -1, "graphics");
+		lua_getfield(L, -1, "getFont");
+		lua_call(L, 0, 1);
+		nk_love_checkFont(-1, font);
+	} else {
+		struct nk_love_font *record = nk_love_acquire_font(NULL);
+		nk_love_set_user_font(font, record);
+		nk_love_release_font(record);
+	}
+	if (memory) {
+		/* a fixed budget: nuklear never allocates beyond this block */
+		context_memory = nk_love_malloc(memory);
+		nk_init_fixed(&context, context_memory, memory, font);
+	} else if (allocator_type == NK_LOVE_ALLOCATOR_POOL) {
+		nk_init(&context, &pool_allocator, font);
+	} else {
+		nk_init_default(&context, font);
+	}
 	font_count = 1;
 	context.clip.copy = nk_love_clipbard_copy;
 	context.clip.paste = nk_love_clipbard_paste;
 	context.clip.userdata = nk_handle_ptr(0);
-	edit_buffer = (char*) nk_love_malloc(NK_LOVE_EDIT_BUFFER_LEN);
-	combobox_items = (const char **) nk_love_malloc(sizeof(char*) * NK_LOVE_COMBOBOX_MAX_ITEMS);
-	floats = (float*) nk_love_malloc(sizeof(float) * NK_MAX(NK_LOVE_MAX_RATIOS, NK_LOVE_MAX_POINTS * 2));
+	if (renderer == NK_LOVE_BATCHED) {
+		nk_love_buffer_init(&draw_commands);
+		nk_love_buffer_init(&draw_vertices);
+		nk_love_buffer_init(&draw_elements);
+	}
 	return 0;
 }
 
@@ -919,17 +2560,60 @@ static int nk_love_shutdown(lua_State *luaState)
 {
 	nk_love_assert_argc(lua_gettop(L) == 0);
 	nk_free(&context);
+	free(context_memory);
+	context_memory = NULL;
 	lua_pushnil(L);
 	lua_setfield(L, LUA_REGISTRYINDEX, "nuklear");
 	L = NULL;
-	free(fonts);
-	fonts = NULL;
+	nk_love_release_fonts();
+	nk_love_font_sweep(1);
+	while (font_chunks) {
+		struct nk_love_font_chunk *next = font_chunks->next;
+		free(font_chunks);
+		font_chunks = next;
+	}
 	free(edit_buffer);
 	edit_buffer = NULL;
+	edit_buffer_size = 0;
 	free(combobox_items);
 	combobox_items = NULL;
-	free(floats);
-	floats = NULL;
+	combobox_capacity = 0;
+	if (renderer == NK_LOVE_BATCHED) {
+		nk_buffer_free(&draw_commands);
+		nk_buffer_free(&draw_vertices);
+		nk_buffer_free(&draw_elements);
+	}
+	if (draw_mesh) {
+		draw_mesh->release();
+		draw_mesh = NULL;
+		draw_mesh_capacity = 0;
+	}
+	if (gradient_mesh) {
+		gradient_mesh->release();
+		gradient_mesh = NULL;
+	}
+	if (frame_canvas) {
+		frame_canvas->release();
+		frame_canvas = NULL;
+	}
+	nk_love_release_layers(1);
+	nk_love_arena_reset(1);
+	if (backend_type == NK_LOVE_BACKEND_RECORD) {
+		nk_buffer_free(&record_buffer);
+		record_frames = 0;
+		record_failed = 0;
+		if (record_file) {
+			fclose(record_file);
+			record_file = NULL;
+		}
+	}
+	if (input_file) {
+		fclose(input_file);
+		input_file = NULL;
+	}
+	nk_love_pool_release();
+	nk_love_quad_cache_sweep(1);
+	nk_love_text_cache_sweep(1);
 	return 0;
 }
 
@@ -1010,97 +2694,606 @@ static int nk_love_wheelmoved(lua_State *L)
 	return 1;
 }
 
-static int nk_love_draw(lua_State *L)
+/*
+ * Pass everything that affects how a command is drawn to emit. Command
+ * memory is zeroed, so struct padding is the same every frame. Pointers
+ * that change from frame to frame are replaced by the Font or Texture
+ * they stand for, compared by identity. Stable output contains no
+ * pointers at all: fonts become their height, textures and custom draw
+ * callbacks are left out, so it can be compared across runs of the same
+ * build. Structs are still written as laid out in memory, so it is not an
+ * interchange format between builds or platforms.
+ */
+typedef void (*nk_love_emit)(void *userdata, const void *data, nk_size size);
+
+static void nk_love_emit_command(const struct nk_command *cmd, int stable,
+	nk_love_emit emit, void *userdata)
+{
+	const char *body = (const char *) cmd + sizeof(struct nk_command);
+	nk_size size;
+	emit(userdata, &cmd->type, sizeof(cmd->type));
+	switch (cmd->type) {
+	case NK_COMMAND_NOP: size = sizeof(struct nk_command); break;
+	case NK_COMMAND_SCISSOR: size = sizeof(struct nk_command_scissor); break;
+	case NK_COMMAND_LINE: size = sizeof(struct nk_command_line); break;
+	case NK_COMMAND_CURVE: size = sizeof(struct nk_command_curve); break;
+	case NK_COMMAND_RECT: size = sizeof(struct nk_command_rect); break;
+	case NK_COMMAND_RECT_FILLED: size = sizeof(struct nk_command_rect_filled); break;
+	case NK_COMMAND_RECT_MULTI_COLOR: size = sizeof(struct nk_command_rect_multi_color); break;
+	case NK_COMMAND_CIRCLE: size = sizeof(struct nk_command_circle); break;
+	case NK_COMMAND_CIRCLE_FILLED: size = sizeof(struct nk_command_circle_filled); break;
+	case NK_COMMAND_ARC: size = sizeof(struct nk_command_arc); break;
+	case NK_COMMAND_ARC_FILLED: size = sizeof(struct nk_command_arc_filled); break;
+	case NK_COMMAND_TRIANGLE: size = sizeof(struct nk_command_triangle); break;
+	case NK_COMMAND_TRIANGLE_FILLED: size = sizeof(struct nk_command_triangle_filled); break;
+	case NK_COMMAND_POLYGON: {
+		const struct nk_command_polygon *p = (const struct nk_command_polygon *)cmd;
+		size = sizeof(*p) + (p->point_count - 1) * sizeof(struct nk_vec2i);
+	} break;
+	case NK_COMMAND_POLYGON_FILLED: {
+		const struct nk_command_polygon_filled *p = (const struct nk_command_polygon_filled *)cmd;
+		size = sizeof(*p) + (p->point_count - 1) * sizeof(struct nk_vec2i);
+	} break;
+	case NK_COMMAND_POLYLINE: {
+		const struct nk_command_polyline *p = (const struct nk_command_polyline *)cmd;
+		size = sizeof(*p) + (p->point_count - 1) * sizeof(struct nk_vec2i);
+	} break;
+	case NK_COMMAND_TEXT: {
+		const struct nk_command_text *t = (const struct nk_command_text *)cmd;
+		if (stable) {
+			emit(userdata, &t->font->height, sizeof(t->font->height));
+		} else {
+			love::graphics::Font *font = ((struct nk_love_font *) t->font->userdata.ptr)->font;
+			emit(userdata, &font, sizeof(font));
+		}
+		emit(userdata, &t->background, sizeof(t->background));
+		emit(userdata, &t->foreground, sizeof(t->foreground));
+		emit(userdata, &t->x, sizeof(t->x) * 2 + sizeof(t->w) * 2);
+		emit(userdata, &t->height, sizeof(t->height));
+		emit(userdata, &t->length, sizeof(t->length));
+		emit(userdata, t->string, t->length);
+		return;
+	}
+	case NK_COMMAND_IMAGE: {
+		const struct nk_command_image *i = (const struct nk_command_image *)cmd;
+		if (!stable) {
+			love::graphics::Texture *texture = nk_love_get_texture(i->img.handle.id);
+			emit(userdata, &texture, sizeof(texture));
+		}
+		emit(userdata, &i->x, sizeof(i->x) * 2 + sizeof(i->w) * 2);
+		emit(userdata, &i->img.w, sizeof(i->img.w) * 2 + sizeof(i->img.region));
+		emit(userdata, &i->col, sizeof(i->col));
+		return;
+	}
+	case NK_COMMAND_CUSTOM: {
+		const struct nk_command_custom *c = (const struct nk_command_custom *)cmd;
+		if (!stable) {
+			size = sizeof(struct nk_command_custom);
+			break;
+		}
+		emit(userdata, &c->x, sizeof(c->x) * 2 + sizeof(c->w) * 2);
+		return;
+	}
+	default: size = sizeof(struct nk_command); break;
+	}
+	emit(userdata, body, size - sizeof(struct nk_command));
+}
+
+static void nk_love_emit_hash(void *userdata, const void *data, nk_size size)
 {
-	lg->push(love::graphics::Graphics::StackType::STACK_ALL);
+	unsigned long long *hash = (unsigned long long *) userdata;
+	*hash = nk_love_hash(*hash, data, size);
+}
+
+static unsigned long long nk_love_hash_command(unsigned long long hash,
+	const struct nk_command *cmd)
+{
+	nk_love_emit_command(cmd, 0, nk_love_emit_hash, &hash);
+	return hash;
+}
 
+static unsigned long long nk_love_hash_frame(void)
+{
+	unsigned long long hash = NK_LOVE_HASH_SEED;
 	const struct nk_command *cmd;
 	nk_foreach(cmd, &context)
-	{
-		switch (cmd->type) {
-		case NK_COMMAND_NOP: break;
-		case NK_COMMAND_SCISSOR: {
-			const struct nk_command_scissor *s =(const struct nk_command_scissor*)cmd;
-			nk_love_scissor(s->x, s->y, s->w, s->h);
-		} break;
-		case NK_COMMAND_LINE: {
-			const struct nk_command_line *l = (const struct nk_command_line *)cmd;
-			nk_love_draw_line(l->begin.x, l->begin.y, l->end.x,
-				l->end.y, l->line_thickness, l->color);
-		} break;
-		case NK_COMMAND_RECT: {
-			const struct nk_command_rect *r = (const struct nk_command_rect *)cmd;
-			nk_love_draw_rect(r->x, r->y, r->w, r->h,
-				(unsigned int)r->rounding, r->line_thickness, r->color);
-		} break;
-		case NK_COMMAND_RECT_FILLED: {
-			const struct nk_command_rect_filled *r = (const struct nk_command_rect_filled *)cmd;
-			nk_love_draw_rect(r->x, r->y, r->w, r->h, (unsigned int)r->rounding, -1, r->color);
-		} break;
-		case NK_COMMAND_CIRCLE: {
-			const struct nk_command_circle *c = (const struct nk_command_circle *)cmd;
-			nk_love_draw_circle(c->x, c->y, c->w, c->h, c->line_thickness, c->color);
-		} break;
-		case NK_COMMAND_CIRCLE_FILLED: {
-			const struct nk_command_circle_filled *c = (const struct nk_command_circle_filled *)cmd;
-			nk_love_draw_circle(c->x, c->y, c->w, c->h, -1, c->color);
-		} break;
-		case NK_COMMAND_TRIANGLE: {
-			const struct nk_command_triangle*t = (const struct nk_command_triangle*)cmd;
-			nk_love_draw_triangle(t->a.x, t->a.y, t->b.x, t->b.y,
-				t->c.x, t->c.y, t->line_thickness, t->color);
-		} break;
-		case NK_COMMAND_TRIANGLE_FILLED: {
-			const struct nk_command_triangle_filled *t = (const struct nk_command_triangle_filled *)cmd;
-			nk_love_draw_triangle(t->a.x, t->a.y, t->b.x, t->b.y, t->c.x, t->c.y, -1, t->color);
-		} break;
-		case NK_COMMAND_POLYGON: {
-			const struct nk_command_polygon *p =(const struct nk_command_polygon*)cmd;
-			nk_love_draw_polygon(p->points, p->point_count, p->line_thickness, p->color);
-		} break;
-		case NK_COMMAND_POLYGON_FILLED: {
-			const struct nk_command_polygon_filled *p = (const struct nk_command_polygon_filled*)cmd;
-			nk_love_draw_polygon(p->points, p->point_count, -1, p->color);
-		} break;
-		case NK_COMMAND_POLYLINE: {
-			const struct nk_command_polyline *p = (const struct nk_command_polyline *)cmd;
-			nk_love_draw_polyline(p->points, p->point_count, p->line_thickness, p->color);
-		} break;
-		case NK_COMMAND_TEXT: {
-			const struct nk_command_text *t = (const struct nk_command_text*)cmd;
-			nk_love_draw_text(t->font->userdata.id, t->background,
-				t->foreground, t->x, t->y, t->w, t->h,
-				t->height, t->length, (const char*)t->string);
-		} break;
-		case NK_COMMAND_CURVE: {
-			const struct nk_command_curve *q = (const struct nk_command_curve *)cmd;
-			nk_love_draw_curve(q->begin, q->ctrl[0], q->ctrl[1],
-				q->end, 22, q->line_thickness, q->color);
-		} break;
-		case NK_COMMAND_RECT_MULTI_COLOR: {
-			const struct nk_command_rect_multi_color *r = (const struct nk_command_rect_multi_color *)cmd;
-			nk_love_draw_rect_multi_color(r->x, r->y, r->w, r->h, r->left, r->top, r->right, r->bottom);
-		} break;
-		case NK_COMMAND_IMAGE: {
-			const struct nk_command_image *i = (const struct nk_command_image *)cmd;
-			nk_love_draw_image(i->x, i->y, i->w, i->h, i->img, i->col);
-		} break;
-		case NK_COMMAND_ARC: {
-			const struct nk_command_arc *a = (const struct nk_command_arc *)cmd;
-			nk_love_draw_arc(a->cx, a->cy, a->r, a->line_thickness,
-				a->a[0], a->a[1], a->color);
-		} break;
-		case NK_COMMAND_ARC_FILLED: {
-			const struct nk_command_arc_filled *a = (const struct nk_command_arc_filled *)cmd;
-			nk_love_draw_arc(a->cx, a->cy, a->r, -1, a->a[0], a->a[1], a->color);
-		} break;
-		default: break;
+		hash = nk_love_hash_command(hash, cmd);
+	return hash;
+}
+
+/*
+ * Draw the commands in [begin, end) with clip being the scissor in
+ * effect when begin is reached.
+ */
+static void nk_love_draw_commands(const struct nk_command *begin,
+	const struct nk_command *end, struct nk_rect clip)
+{
+	draw_clip = clip;
+	if (renderer == NK_LOVE_BATCHED) {
+		nk_love_draw_batched(begin, end);
+	} else {
+		if (clip.w != nk_null_rect.w || clip.h != nk_null_rect.h)
+			nk_love_scissor(clip.x, clip.y, clip.w, clip.h);
+		nk_love_draw_immediate(begin, end);
+	}
+}
+
+/*
+ * Render the commands into a screen sized canvas when they differ from
+ * what the canvas holds, then composite the canvas. Idle frames cost a
+ * single textured quad.
+ */
+static void nk_love_draw_cached(void)
+{
+	int width = lg->getWidth(), height = lg->getHeight();
+	if (frame_canvas && (frame_canvas->getWidth() != width || frame_canvas->getHeight() != height)) {
+		frame_canvas->release();
+		frame_canvas = NULL;
+	}
+	if (!frame_canvas || frame_canvas_hash != frame_hash) {
+		if (!frame_canvas) {
+			love::graphics::Canvas::Settings settings;
+			settings.width = width;
+			settings.height = height;
+			settings.dpiScale = lg->getScreenDPIScale();
+			frame_canvas = lg->newCanvas(settings);
+		}
+		love::graphics::Graphics::RenderTargets targets;
+		targets.colors.push_back(love::graphics::Graphics::RenderTarget(frame_canvas));
+		lg->push(love::graphics::Graphics::StackType::STACK_ALL);
+		lg->setCanvas(targets);
+		lg->origin();
+		lg->setScissor();
+		lg->clear(love::graphics::OptionalColorf(love::graphics::Colorf(0, 0, 0, 0)),
+			love::OptionalInt(), love::OptionalDouble());
+		nk_love_reset_state();
+		nk_love_draw_commands(nk__begin(&context), NULL, nk_null_rect);
+		lg->pop();
+		frame_canvas_hash = frame_hash;
+		stats.frames_rendered++;
+	} else {
+		stats.frames_reused++;
+	}
+	nk_love_reset_state();
+	lg->setScissor();
+	lg->setColor(love::graphics::Colorf(1, 1, 1, 1));
+	lg->setBlendMode(love::graphics::Graphics::BLEND_ALPHA,
+		love::graphics::Graphics::BLENDALPHA_PREMULTIPLIED);
+	stats.draw_calls++;
+	frame_canvas->draw(lg, love::Matrix4());
+}
+
+/* window of the previous lookup, only valid during one nk_love_draw_windows */
+static struct nk_window *command_window;
+
+static struct nk_window *nk_love_command_window(const struct nk_command *cmd)
+{
+	struct nk_window *last = command_window;
+	nk_size offset = (nk_size) ((const char *) cmd - (const char *) context.memory.memory.ptr);
+	struct nk_window *win;
+	if (last && offset >= last->buffer.begin && offset < last->buffer.end)
+		return last;
+	for (win = context.begin; win; win = win->next) {
+		if (offset >= win->buffer.begin && offset < win->buffer.end) {
+			command_window = win;
+			return win;
+		}
+	}
+	return NULL;
+}
+
+static struct nk_love_layer *nk_love_get_layer(struct nk_window *win, int w, int h)
+{
+	struct nk_love_layer *free_layer = NULL;
+	int index = 0;
+	int i;
+	for (i = 0; i < NK_LOVE_MAX_LAYERS; ++i) {
+		if (layers[i].window == win && layers[i].name == win->name && layers[i].frame == frame_count)
+			index++;
+	}
+	for (i = 0; i < NK_LOVE_MAX_LAYERS; ++i) {
+		struct nk_love_layer *layer = &layers[i];
+		if (!layer->window) {
+			if (!free_layer)
+				free_layer = layer;
+			continue;
+		}
+		if (layer->window == win && layer->name == win->name && layer->index == index && layer->frame != frame_count) {
+			if (layer->w != w || layer->h != h) {
+				layer->canvas->release();
+				layer->canvas = NULL;
+			}
+			free_layer = layer;
+			break;
+		}
+	}
+	if (!free_layer)
+		return NULL;
+	if (!free_layer->canvas) {
+		love::graphics::Canvas::Settings settings;
+		settings.width = w;
+		settings.height = h;
+		settings.dpiScale = lg->getScreenDPIScale();
+		free_layer->canvas = lg->newCanvas(settings);
+		free_layer->hash = 0;
+	}
+	free_layer->window = win;
+	free_layer->name = win->name;
+	free_layer->index = index;
+	free_layer->w = w;
+	free_layer->h = h;
+	free_layer->frame = frame_count;
+	return free_layer;
+}
+
+static void nk_love_release_layers(int all)
+{
+	int i;
+	for (i = 0; i < NK_LOVE_MAX_LAYERS; ++i) {
+		struct nk_love_layer *layer = &layers[i];
+		if (layer->window && (all || layer->frame != frame_count)) {
+			layer->canvas->release();
+			nk_zero_struct(*layer);
 		}
 	}
+}
+
+/*
+ * Split the command list into runs owned by one window and draw each run
+ * through its own canvas, re-rendering only the runs whose hash changed.
+ * Commands outside any window are drawn directly.
+ */
+static void nk_love_draw_windows(void)
+{
+	struct nk_rect clip = nk_null_rect;
+	const struct nk_command *cmd = nk__begin(&context);
+	/* windows may have been freed since the last frame */
+	command_window = NULL;
+	while (cmd) {
+		struct nk_window *win = nk_love_command_window(cmd);
+		const struct nk_command *begin = cmd;
+		struct nk_rect run_clip = clip;
+		struct nk_rect bounds = nk_rect(0, 0, 0, 0);
+		unsigned long long hash = nk_love_hash(NK_LOVE_HASH_SEED, &run_clip, sizeof(run_clip));
+		for (; cmd && nk_love_command_window(cmd) == win; cmd = nk__next(&context, cmd)) {
+			hash = nk_love_hash_command(hash, cmd);
+			if (cmd->type == NK_COMMAND_SCISSOR) {
+				const struct nk_command_scissor *s = (const struct nk_command_scissor *)cmd;
+				clip = nk_rect(s->x, s->y, s->w, s->h);
+				continue;
+			}
+			struct nk_rect b = nk_love_intersect(nk_love_drawn_bounds(cmd), clip);
+			if (b.w <= 0 || b.h <= 0)
+				continue;
+			if (bounds.w <= 0 || bounds.h <= 0) {
+				bounds = b;
+			} else {
+				float x1 = NK_MAX(bounds.x + bounds.w, b.x + b.w);
+				float y1 = NK_MAX(bounds.y + bounds.h, b.y + b.h);
+				bounds.x = NK_MIN(bounds.x, b.x);
+				bounds.y = NK_MIN(bounds.y, b.y);
+				bounds.w = x1 - bounds.x;
+				bounds.h = y1 - bounds.y;
+			}
+		}
+		/* draw_screen accounts for the transform nk.draw runs under */
+		bounds = nk_love_intersect(bounds, draw_screen);
+		if (bounds.w <= 0 || bounds.h <= 0)
+			continue;
+		int x = (int) bounds.x, y = (int) bounds.y;
+		int w = (int) ceilf(bounds.x + bounds.w) - x;
+		int h = (int) ceilf(bounds.y + bounds.h) - y;
+		struct nk_love_layer *layer = win ? nk_love_get_layer(win, w, h) : NULL;
+		if (!layer) {
+			nk_love_draw_commands(begin, cmd, run_clip);
+			continue;
+		}
+		if (layer->hash != hash || layer->x != x || layer->y != y) {
+			love::graphics::Graphics::RenderTargets targets;
+			targets.colors.push_back(love::graphics::Graphics::RenderTarget(layer->canvas));
+			lg->push(love::graphics::Graphics::StackType::STACK_ALL);
+			lg->setCanvas(targets);
+			lg->origin();
+			lg->translate(-x, -y);
+			lg->setScissor();
+			lg->clear(love::graphics::OptionalColorf(love::graphics::Colorf(0, 0, 0, 0)),
+				love::OptionalInt(), love::OptionalDouble());
+			nk_love_reset_state();
+			draw_offset = nk_vec2(x, y);
+			nk_love_draw_commands(begin, cmd, run_clip);
+			draw_offset = nk_vec2(0, 0);
+			lg->pop();
+			nk_love_reset_state();
+			layer->hash = hash;
+			layer->x = x;
+			layer->y = y;
+			stats.layers_rendered++;
+		} else {
+			stats.layers_reused++;
+		}
+		lg->push(love::graphics::Graphics::StackType::STACK_ALL);
+		lg->setScissor();
+		lg->setColor(love::graphics::Colorf(1, 1, 1, 1));
+		lg->setBlendMode(love::graphics::Graphics::BLEND_ALPHA,
+			love::graphics::Graphics::BLENDALPHA_PREMULTIPLIED);
+		stats.draw_calls++;
+		layer->canvas->draw(lg, love::Matrix4(x, y, 0, 1, 1, 0, 0, 0, 0));
+		lg->pop();
+	}
+	nk_love_release_layers(0);
+}
+
+/*
+ * The screen in command coordinates. Commands can only be culled against
+ * it when nk.draw is called without a transform.
+ */
+static struct nk_rect nk_love_screen_rect(void)
+{
+	static const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+	if (memcmp(lg->getTransform().getElements(), identity, sizeof(identity)))
+		return nk_null_rect;
+	return nk_rect(0, 0, lg->getWidth(), lg->getHeight());
+}
+
+static void nk_love_graphics_begin(void)
+{
+	lg->push(love::graphics::Graphics::StackType::STACK_ALL);
+	nk_love_reset_state();
+	draw_screen = nk_love_screen_rect();
+}
+
+static void nk_love_graphics_draw(void)
+{
+	if (frame_cache == NK_LOVE_CACHE_FRAME)
+		nk_love_draw_cached();
+	else if (frame_cache == NK_LOVE_CACHE_WINDOW)
+		nk_love_draw_windows();
+	else
+		nk_love_draw_commands(nk__begin(&context), NULL, nk_null_rect);
+}
 
+static void nk_love_graphics_end(void)
+{
 	lg->pop();
+}
+
+static const struct nk_love_backend graphics_backend = {
+	nk_love_graphics_begin,
+	nk_love_graphics_draw,
+	nk_love_graphics_end
+};
+
+/*
+ * Recorded frames are a "NKFR" tag, the frame number and the command
+ * count, followed by each command as its byte size and its stable
+ * serialization, all in native byte order. Without a record path the
+ * frames stay in memory until nk.takeRecording; once they pass the
+ * record limit the frames not yet taken are dropped.
+ */
+static void nk_love_record_write(const void *data, nk_size size)
+{
+	if (size)
+		nk_buffer_push(&record_buffer, NK_BUFFER_FRONT, data, size, 1);
+}
+
+static void nk_love_emit_record(void *userdata, const void *data, nk_size size)
+{
+	(void) userdata;
+	nk_love_record_write(data, size);
+}
+
+static void nk_love_record_patch(nk_size offset, nk_uint value)
+{
+	memcpy((char *) nk_buffer_memory(&record_buffer) + offset, &value, sizeof(value));
+}
+
+static void nk_love_record_begin(void)
+{
+	nk_uint frame = frame_count;
+	if (!record_file && record_buffer.allocated >= record_limit) {
+		/* nobody took the recording in time, start over and say so */
+		stats.record_frames_dropped += record_frames;
+		record_frames = 0;
+		nk_buffer_clear(&record_buffer);
+	}
+	record_frames++;
+	record_frame = record_buffer.allocated;
+	record_count = 0;
+	nk_love_record_write("NKFR", 4);
+	nk_love_record_write(&frame, sizeof(frame));
+	nk_love_record_write(&record_count, sizeof(record_count));
+}
+
+static void nk_love_record_draw(void)
+{
+	const struct nk_command *cmd;
+	nk_foreach(cmd, &context)
+	{
+		nk_size offset = record_buffer.allocated;
+		nk_uint size = 0;
+		nk_love_record_write(&size, sizeof(size));
+		nk_love_emit_command(cmd, 1, nk_love_emit_record, NULL);
+		nk_love_record_patch(offset, (nk_uint) (record_buffer.allocated - offset - sizeof(size)));
+		record_count++;
+	}
+}
+
+static void nk_love_record_end(void)
+{
+	nk_love_record_patch(record_frame + 4 + sizeof(nk_uint), record_count);
+	if (record_file) {
+		nk_size written = fwrite(nk_buffer_memory(&record_buffer), 1, record_buffer.allocated, record_file);
+		record_failed = written != record_buffer.allocated;
+		record_frames = 0;
+		nk_buffer_clear(&record_buffer);
+	}
+}
+
+static const struct nk_love_backend record_backend = {
+	nk_love_record_begin,
+	nk_love_record_draw,
+	nk_love_record_end
+};
+
+static int nk_love_draw(lua_State *L)
+{
+	double start = love::timer::Timer::getTime();
+	nk_zero_struct(stats);
+	stats.memory_used = context.memory.allocated;
+	stats.memory_size = context.memory.memory.size;
+	stats.memory_needed = context.memory.needed;
+	stats.memory_calls = context.memory.calls;
+	/* count what was built, whether or not a cache skips drawing it */
+	const struct nk_command *cmd;
+	nk_foreach(cmd, &context)
+		stats.commands[cmd->type]++;
+	frame_count++;
+	const struct nk_love_backend *backend = &graphics_backend;
+	if (backend_type == NK_LOVE_BACKEND_RECORD)
+		backend = &record_backend;
+	backend->begin();
+
+	NK_LOVE_ZONE_BEGIN(replay_start);
+	backend->draw();
+	NK_LOVE_ZONE_END("replay", replay_start);
+
+	backend->end();
+	if (frame_count % NK_LOVE_QUAD_CACHE_TTL == 0)
+		nk_love_quad_cache_sweep(0);
+	if (frame_count % NK_LOVE_TEXT_CACHE_TTL == 0)
+		nk_love_text_cache_sweep(0);
+	nk_love_arena_reset(0);
 	nk_clear(&context);
+	stats.pool_allocations = pool.allocations;
+	stats.pool_frees = pool.frees;
+	stats.pool_system_allocations = pool.system_allocations;
+	stats.pool_live_bytes = pool.live_bytes;
+	stats.pool_peak_bytes = pool.peak_bytes;
+	pool.allocations = 0;
+	pool.frees = 0;
+	pool.system_allocations = 0;
+	stats.draw_time = love::timer::Timer::getTime() - start;
+	nk_love_assert(!record_failed, "%s: could not write the frame recording");
+	return 0;
+}
+
+static int nk_love_get_stats(lua_State *L)
+{
+	nk_love_assert_argc(lua_gettop(L) == 0);
+	lua_newtable(L);
+	lua_pushnumber(L, stats.state_changes);
+	lua_setfield(L, -2, "state changes");
+	lua_pushnumber(L, stats.state_changes_skipped);
+	lua_setfield(L, -2, "state changes skipped");
+	lua_pushnumber(L, stats.quads_created);
+	lua_setfield(L, -2, "quads created");
+	lua_pushnumber(L, stats.quad_cache_hits);
+	lua_setfield(L, -2, "quad cache hits");
+	lua_pushnumber(L, stats.texts_created);
+	lua_setfield(L, -2, "texts created");
+	lua_pushnumber(L, stats.text_cache_hits);
+	lua_setfield(L, -2, "text cache hits");
+	lua_pushnumber(L, stats.frames_rendered);
+	lua_setfield(L, -2, "frames rendered");
+	lua_pushnumber(L, stats.frames_reused);
+	lua_setfield(L, -2, "frames reused");
+	lua_pushnumber(L, stats.layers_rendered);
+	lua_setfield(L, -2, "layers rendered");
+	lua_pushnumber(L, stats.layers_reused);
+	lua_setfield(L, -2, "layers reused");
+	lua_pushnumber(L, stats.commands_culled);
+	lua_setfield(L, -2, "commands culled");
+	lua_pushnumber(L, stats.record_frames_dropped);
+	lua_setfield(L, -2, "recorded frames dropped");
+	unsigned int width_hits = font_width_hits, width_misses = font_width_misses;
+	struct nk_love_font *record;
+	for (record = font_records; record; record = record->next) {
+		width_hits += record->width_hits;
+		width_misses += record->width_misses;
+	}
+	lua_pushnumber(L, width_hits);
+	lua_setfield(L, -2, "total text width hits");
+	lua_pushnumber(L, width_misses);
+	lua_setfield(L, -2, "total text width misses");
+	lua_pushnumber(L, build_stats.text_width_hits);
+	lua_setfield(L, -2, "text width hits");
+	lua_pushnumber(L, build_stats.text_width_misses);
+	lua_setfield(L, -2, "text width misses");
+	lua_pushnumber(L, build_stats.text_width_calls);
+	lua_setfield(L, -2, "text width calls");
+	lua_newtable(L);
+	int i;
+	for (i = 0; i <= NK_COMMAND_CUSTOM; ++i) {
+		lua_pushnumber(L, stats.commands[i]);
+		lua_setfield(L, -2, command_names[i]);
+	}
+	lua_setfield(L, -2, "commands");
+	lua_pushnumber(L, stats.draw_calls);
+	lua_setfield(L, -2, "draw calls");
+	lua_pushnumber(L, stats.memory_used);
+	lua_setfield(L, -2, "memory used");
+	lua_pushnumber(L, stats.memory_size);
+	lua_setfield(L, -2, "memory size");
+	lua_pushnumber(L, stats.memory_needed);
+	lua_setfield(L, -2, "memory needed");
+	lua_pushnumber(L, stats.memory_calls);
+	lua_setfield(L, -2, "memory calls");
+	lua_pushnumber(L, stats.pool_allocations);
+	lua_setfield(L, -2, "pool allocations");
+	lua_pushnumber(L, stats.pool_frees);
+	lua_setfield(L, -2, "pool frees");
+	lua_pushnumber(L, stats.pool_system_allocations);
+	lua_setfield(L, -2, "pool system allocations");
+	lua_pushnumber(L, stats.pool_live_bytes);
+	lua_setfield(L, -2, "pool live bytes");
+	lua_pushnumber(L, stats.pool_peak_bytes);
+	lua_setfield(L, -2, "pool peak bytes");
+	lua_pushnumber(L, build_stats.frame_begin_time);
+	lua_setfield(L, -2, "frame begin time");
+	lua_pushnumber(L, build_stats.build_time);
+	lua_setfield(L, -2, "build time");
+	lua_pushnumber(L, stats.draw_time);
+	lua_setfield(L, -2, "draw time");
+	return 1;
+}
+
+static int nk_love_take_recording(lua_State *L)
+{
+	nk_love_assert_argc(lua_gettop(L) == 0);
+	nk_love_assert(backend_type == NK_LOVE_BACKEND_RECORD, "%s: requires the record backend");
+	lua_pushlstring(L, (const char *) nk_buffer_memory(&record_buffer), record_buffer.allocated);
+	record_frames = 0;
+	nk_buffer_clear(&record_buffer);
+	return 1;
+}
+
+static int nk_love_dump_trace(lua_State *L)
+{
+	nk_love_assert_argc(lua_gettop(L) == 1);
+	const char *path = luaL_checkstring(L, 1);
+#ifdef NK_LOVE_TRACE
+	FILE *file = fopen(path, "w");
+	const char *msg = lua_pushfstring(L, "%%s: could not open '%s' for writing", path);
+	nk_love_assert(file != NULL, msg);
+	lua_pop(L, 1);
+	unsigned int first = (trace_head + NK_LOVE_TRACE_SIZE - trace_count) % NK_LOVE_TRACE_SIZE;
+	unsigned int i;
+	fputs("{\"traceEvents\":[\n", file);
+	for (i = 0; i < trace_count; ++i) {
+		const struct nk_love_trace_event *event = &trace_events[(first + i) % NK_LOVE_TRACE_SIZE];
+		fprintf(file, "{\"name\":\"%s\",\"cat\":\"nuklear\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}%s\n",
+			event->name, event->start * 1e6, event->duration * 1e6,
+			i + 1 < trace_count ? "," : "");
+	}
+	fputs("]}\n", file);
+	nk_love_assert(fclose(file) == 0, "%s: could not write the trace");
+	trace_head = trace_count = 0;
 	return 0;
+#else
+	(void) path;
+	nk_love_assert(0, "%s: tracing requires building with NK_LOVE_TRACE");
+	return 0;
+#endif
 }
 
 static void nk_love_preserve(struct nk_style_item *item)
@@ -1235,46 +3428,208 @@ static void nk_love_preserve_all(void)
 static int nk_love_frame_begin(lua_State *L)
 {
 	nk_love_assert_argc(lua_gettop(L) == 0);
+	double start = love::timer::Timer::getTime();
+	nk_zero_struct(build_stats);
 	nk_input_end(&context);
-	lua_getglobal(L, "love");
-	lua_getfield(L, -1, "timer");
-	lua_getfield(L, -1, "getDelta");
-	lua_call(L, 0, 1);
-	float dt = lua_tonumber(L, -1);
+	float dt = input_delta;
+	if (!input_replaying) {
+		lua_getglobal(L, "love");
+		lua_getfield(L, -1, "timer");
+		lua_getfield(L, -1, "getDelta");
+		lua_call(L, 0, 1);
+		dt = lua_tonumber(L, -1);
+	}
+	nk_love_input_frame(dt);
 	context.delta_time_seconds = dt;
+	nk_love_arena_reset(0);
 	lua_getfield(L, LUA_REGISTRYINDEX, "nuklear");
 	lua_getfield(L, -1, "image");
 	lua_newtable(L);
 	lua_setfield(L, -3, "image");
 	nk_love_preserve_all();
 	lua_pop(L, 1);
-	lua_getfield(L, -1, "font");
-	lua_newtable(L);
-	lua_setfield(L, -3, "font");
-	font_count = 0;
-	lua_rawgeti(L, -1, context.style.font->userdata.id);
-	nk_love_checkFont(-1, &fonts[font_count]);
-	lua_pop(L, 1);
-	context.style.font = &fonts[font_count++];
+	/* keep the fonts still referenced by the style while the slots are recycled */
+	struct nk_love_font *style_font = (struct nk_love_font *) context.style.font->userdata.ptr;
+	struct nk_love_font *stack_fonts[NK_FONT_STACK_SIZE];
 	int i;
+	style_font->refs++;
 	for (i = 0; i < context.stacks.fonts.head; ++i) {
-		struct nk_config_stack_user_font_element *element = &context.stacks.fonts.elements[i];
-		lua_rawgeti(L, -1, element->old_value->userdata.id);
-		nk_love_checkFont(-1, &fonts[font_count]);
-		lua_pop(L, 1);
-		context.stacks.fonts.elements[i].old_value = &fonts[font_count++];
+		stack_fonts[i] = (struct nk_love_font *) context.stacks.fonts.elements[i].old_value->userdata.ptr;
+		stack_fonts[i]->refs++;
 	}
-	layout_ratio_count = 0;
+	nk_love_release_fonts();
+	struct nk_user_font *font = nk_love_font_slot(font_count++);
+	nk_love_set_user_font(font, style_font);
+	nk_love_release_font(style_font);
+	context.style.font = font;
+	for (i = 0; i < context.stacks.fonts.head; ++i) {
+		font = nk_love_font_slot(font_count++);
+		nk_love_set_user_font(font, stack_fonts[i]);
+		nk_love_release_font(stack_fonts[i]);
+		context.stacks.fonts.elements[i].old_value = font;
+	}
+	nk_love_font_sweep(0);
+	build_stats.build_start = love::timer::Timer::getTime();
+	build_stats.frame_begin_time = build_stats.build_start - start;
 	return 0;
 }
 
 static int nk_love_frame_end(lua_State *L)
 {
 	nk_love_assert_argc(lua_gettop(L) == 0);
+	build_stats.build_time = love::timer::Timer::getTime() - build_stats.build_start;
+	if (context_memory && context.memory.needed > context.memory.memory.size) {
+		const char *msg = lua_pushfstring(L, "%%s: UI memory budget of %f bytes exceeded (%f bytes needed)",
+			(lua_Number) context.memory.memory.size, (lua_Number) context.memory.needed);
+		/* drop the truncated frame so the next one starts from an empty buffer */
+		nk_clear(&context);
+		nk_input_begin(&context);
+		nk_love_assert(0, msg);
+	}
+	/* only pay for the hash when the frame cache or nk.frameChanged needs it */
+	if (frame_cache == NK_LOVE_CACHE_FRAME || frame_hash_requested) {
+		NK_LOVE_ZONE_BEGIN(hash_start);
+		unsigned long long hash = nk_love_hash_frame();
+		NK_LOVE_ZONE_END("frame hash", hash_start);
+		frame_changed = hash != frame_hash;
+		frame_hash = hash;
+	}
 	nk_input_begin(&context);
 	return 0;
 }
 
+static int nk_love_frame_changed(lua_State *L)
+{
+	nk_love_assert_argc(lua_gettop(L) == 0);
+	/* frames are hashed from now on; until then every frame counts as changed */
+	frame_hash_requested = 1;
+	lua_pushboolean(L, frame_changed);
+	return 1;
+}
+
+static int nk_love_input_record_begin(lua_State *L)
+{
+	nk_love_assert_argc(lua_gettop(L) == 1);
+	const char *path = luaL_checkstring(L, 1);
+	nk_love_assert(!input_file, "%s: already recording");
+	nk_love_assert(!input_replaying, "%s: cannot record while replaying");
+	input_file = fopen(path, "wb");
+	const char *msg = lua_pushfstring(L, "%%s: could not open '%s' for writing", path);
+	nk_love_assert(input_file != NULL, msg);
+	lua_pop(L, 1);
+	if (fwrite(NK_LOVE_INPUT_MAGIC, 1, 4, input_file) != 4) {
+		fclose(input_file);
+		input_file = NULL;
+		msg = lua_pushfstring(L, "%%s: could not write to '%s'", path);
+		nk_love_assert(0, msg);
+	}
+	return 0;
+}
+
+static int nk_love_input_record_end(lua_State *L)
+{
+	nk_love_assert_argc(lua_gettop(L) == 0);
+	nk_love_assert(input_file != NULL, "%s: not recording");
+	/* buffered events only reach the file here */
+	int closed = fclose(input_file) == 0;
+	input_file = NULL;
+	nk_love_assert(closed, "%s: could not write the input recording");
+	return 0;
+}
+
+static int nk_love_replay_read(FILE *file, nk_int *values, int count)
+{
+	return fread(values, sizeof(nk_int), count, file) == (size_t) count;
+}
+
+/*
+ * Run one recorded frame: frameBegin with the recorded delta time, the
+ * caller's UI function, frameEnd and draw.
+ */
+static int nk_love_replay_frame(lua_State *L)
+{
+	lua_pushcfunction(L, nk_love_frame_begin);
+	lua_call(L, 0, 0);
+	lua_pushvalue(L, 1);
+	lua_call(L, 0, 0);
+	lua_pushcfunction(L, nk_love_frame_end);
+	lua_call(L, 0, 0);
+	lua_pushcfunction(L, nk_love_draw);
+	lua_call(L, 0, 0);
+	return 0;
+}
+
+static int nk_love_replay(lua_State *L)
+{
+	nk_love_assert_argc(lua_gettop(L) == 2);
+	const char *path = luaL_checkstring(L, 1);
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+	nk_love_assert(!input_replaying, "%s: already replaying");
+	nk_love_assert(!input_file, "%s: cannot replay while recording");
+	FILE *file = fopen(path, "rb");
+	const char *msg = lua_pushfstring(L, "%%s: could not open '%s' for reading", path);
+	nk_love_assert(file != NULL, msg);
+	lua_pop(L, 1);
+	char magic[4];
+	int valid = fread(magic, 1, 4, file) == 4 && !memcmp(magic, NK_LOVE_INPUT_MAGIC, 4);
+	int frames = 0, failed = 0, type;
+	nk_int values[4];
+	input_replaying = 1;
+	while (valid && !failed && (type = fgetc(file)) != EOF) {
+		switch (type) {
+		case NK_LOVE_INPUT_FRAME:
+			valid = nk_love_replay_read(file, values, 1);
+			if (!valid)
+				break;
+			memcpy(&input_delta, &values[0], sizeof(input_delta));
+			lua_pushcfunction(L, nk_love_replay_frame);
+			lua_pushvalue(L, 2);
+			failed = lua_pcall(L, 1, 0, 0);
+			frames++;
+			break;
+		case NK_LOVE_INPUT_KEY:
+			valid = nk_love_replay_read(file, values, 2);
+			if (valid)
+				nk_input_key(&context, (enum nk_keys) values[0], values[1]);
+			break;
+		case NK_LOVE_INPUT_BUTTON:
+			valid = nk_love_replay_read(file, values, 4);
+			if (valid)
+				nk_input_button(&context, (enum nk_buttons) values[0], values[1], values[2], values[3]);
+			break;
+		case NK_LOVE_INPUT_MOTION:
+			valid = nk_love_replay_read(file, values, 2);
+			if (valid)
+				nk_input_motion(&context, values[0], values[1]);
+			break;
+		case NK_LOVE_INPUT_UNICODE:
+			valid = nk_love_replay_read(file, values, 1);
+			if (valid)
+				nk_input_unicode(&context, (nk_rune) values[0]);
+			break;
+		case NK_LOVE_INPUT_SCROLL:
+			valid = nk_love_replay_read(file, values, 1);
+			if (valid) {
+				float y;
+				memcpy(&y, &values[0], sizeof(y));
+				nk_input_scroll(&context, y);
+			}
+			break;
+		default:
+			valid = 0;
+		}
+	}
+	input_replaying = 0;
+	fclose(file);
+	if (failed)
+		return lua_error(L);
+	msg = lua_pushfstring(L, "%%s: '%s' is not a valid input recording", path);
+	nk_love_assert(valid, msg);
+	lua_pop(L, 1);
+	lua_pushnumber(L, frames);
+	return 1;
+}
+
 static int nk_love_window_begin(lua_State *L)
 {
 	const char *name, *title;
@@ -1513,16 +3868,18 @@ static int nk_love_layout_row(lua_State *L)
 	}
 	if (use_ratios) {
 		int cols = lua_objlen(L, -1);
-		int i, j;
-		for (i = 1, j = layout_ratio_count; i <= cols && j < NK_LOVE_MAX_RATIOS; ++i, ++j) {
+		/* nuklear reads the ratios until the row ends; the arena keeps them for the frame */
+		float *ratios = (float *) nk_love_arena_alloc(sizeof(float) * NK_MAX(cols, 1));
+		nk_love_assert_alloc(ratios);
+		int i;
+		for (i = 1; i <= cols; ++i) {
 			lua_rawgeti(L, -1, i);
 			if (!lua_isnumber(L, -1))
 				luaL_argerror(L, lua_gettop(L) - 1, "should contain numbers only");
-			floats[j] = lua_tonumber(L, -1);
+			ratios[i - 1] = lua_tonumber(L, -1);
 			lua_pop(L, 1);
 		}
-		nk_layout_row(&context, format, height, cols, floats + layout_ratio_count);
-		layout_ratio_count += cols;
+		nk_layout_row(&context, format, height, cols, ratios);
 	}
 	return 0;
 }
@@ -2127,24 +4484,204 @@ static int nk_love_property(lua_State *L)
 	return 1;
 }
 
-static int nk_love_edit(lua_State *L)
+/*
+ * Whether the next edit widget may change its text this frame: it is the
+ * window's active edit, or a click may be about to activate it.
+ */
+static int nk_love_edit_is_live(void)
+{
+	struct nk_window *win = context.current;
+	if (!win)
+		return 1;
+	if (win->edit.active && win->edit.name == win->edit.seq)
+		return 1;
+	return context.input.mouse.buttons[NK_BUTTON_LEFT].clicked;
+}
+
+/*
+ * Text document created by nk.newTextBuffer. The nk_text_edit keeps its
+ * text and cursor between frames, so nk.edit works on it in place; nuklear
+ * clears the undo history whenever the field is activated. Every edit
+ * leaves an undo record, so changes are found without looking at the text,
+ * and the line index is rebuilt lazily after the text changes. Nuklear's
+ * multi-line layout still walks the whole text every frame the field is
+ * drawn, so drawing remains linear in the document size.
+ */
+#define NK_LOVE_TEXT_BUFFER "nuklear.TextBuffer"
+
+struct nk_love_text_buffer {
+	struct nk_text_edit edit;
+	nk_size *lines;
+	nk_size line_capacity;
+	int line_count;
+	int lines_dirty;
+};
+
+static int nk_love_is_text_buffer(int index)
+{
+	if (!lua_isuserdata(L, index) || !lua_getmetatable(L, index))
+		return 0;
+	luaL_getmetatable(L, NK_LOVE_TEXT_BUFFER);
+	int is_buffer = lua_rawequal(L, -1, -2);
+	lua_pop(L, 2);
+	return is_buffer;
+}
+
+/*
+ * Text buffers outlive nk.init and nk.shutdown, so their methods check
+ * arguments and report errors on the state they were called with.
+ */
+static void nk_love_text_buffer_assert(lua_State *L, int pass, const char *msg)
+{
+	if (!pass) {
+		lua_Debug ar;
+		ar.name = NULL;
+		if (lua_getstack(L, 0, &ar))
+			lua_getinfo(L, "n", &ar);
+		if (ar.name == NULL)
+			ar.name = "?";
+		luaL_error(L, msg, ar.name);
+	}
+}
+
+static struct nk_love_text_buffer *nk_love_checkTextBuffer(lua_State *L, int index)
+{
+	return (struct nk_love_text_buffer *) luaL_checkudata(L, index, NK_LOVE_TEXT_BUFFER);
+}
+
+static void nk_love_text_buffer_set(struct nk_love_text_buffer *buffer, const char *text, size_t len)
+{
+	nk_str_clear(&buffer->edit.string);
+	nk_str_append_text_char(&buffer->edit.string, text, (int) len);
+	nk_textedit_clear_state(&buffer->edit, NK_TEXT_EDIT_MULTI_LINE, nk_filter_default);
+	buffer->lines_dirty = 1;
+}
+
+static void nk_love_text_buffer_add_line(lua_State *L, struct nk_love_text_buffer *buffer, nk_size start)
+{
+	if ((nk_size) buffer->line_count >= buffer->line_capacity) {
+		nk_size capacity = NK_MAX(buffer->line_capacity * 2, 64);
+		nk_size *lines = (nk_size *) realloc(buffer->lines, capacity * sizeof(nk_size));
+		nk_love_text_buffer_assert(L, lines != NULL, "out of memory in '%s'");
+		buffer->lines = lines;
+		buffer->line_capacity = capacity;
+	}
+	buffer->lines[buffer->line_count++] = start;
+}
+
+static void nk_love_text_buffer_index(lua_State *L, struct nk_love_text_buffer *buffer)
+{
+	if (!buffer->lines_dirty)
+		return;
+	const char *text = (const char *) nk_str_get_const(&buffer->edit.string);
+	int len = nk_str_len_char(&buffer->edit.string);
+	int i;
+	buffer->line_count = 0;
+	nk_love_text_buffer_add_line(L, buffer, 0);
+	for (i = 0; i < len; ++i) {
+		if (text[i] == '\n')
+			nk_love_text_buffer_add_line(L, buffer, i + 1);
+	}
+	buffer->lines_dirty = 0;
+}
+
+static int nk_love_text_buffer_gc(lua_State *L)
+{
+	/* may run after nk.shutdown, so use the collector's state */
+	struct nk_love_text_buffer *buffer = (struct nk_love_text_buffer *)
+		luaL_checkudata(L, 1, NK_LOVE_TEXT_BUFFER);
+	nk_textedit_free(&buffer->edit);
+	free(buffer->lines);
+	buffer->lines = NULL;
+	return 0;
+}
+
+static int nk_love_text_buffer_get_text(lua_State *L)
+{
+	nk_love_text_buffer_assert(L, lua_gettop(L) == 1, "wrong number of arguments to '%s'");
+	struct nk_love_text_buffer *buffer = nk_love_checkTextBuffer(L, 1);
+	const char *text = (const char *) nk_str_get_const(&buffer->edit.string);
+	lua_pushlstring(L, text ? text : "", nk_str_len_char(&buffer->edit.string));
+	return 1;
+}
+
+static int nk_love_text_buffer_set_text(lua_State *L)
+{
+	nk_love_text_buffer_assert(L, lua_gettop(L) == 2, "wrong number of arguments to '%s'");
+	struct nk_love_text_buffer *buffer = nk_love_checkTextBuffer(L, 1);
+	size_t len;
+	const char *text = luaL_checklstring(L, 2, &len);
+	nk_love_text_buffer_set(buffer, text, len);
+	return 0;
+}
+
+static int nk_love_text_buffer_get_length(lua_State *L)
+{
+	nk_love_text_buffer_assert(L, lua_gettop(L) == 1, "wrong number of arguments to '%s'");
+	struct nk_love_text_buffer *buffer = nk_love_checkTextBuffer(L, 1);
+	lua_pushnumber(L, nk_str_len_char(&buffer->edit.string));
+	return 1;
+}
+
+static int nk_love_text_buffer_get_line_count(lua_State *L)
+{
+	nk_love_text_buffer_assert(L, lua_gettop(L) == 1, "wrong number of arguments to '%s'");
+	struct nk_love_text_buffer *buffer = nk_love_checkTextBuffer(L, 1);
+	nk_love_text_buffer_index(L, buffer);
+	lua_pushnumber(L, buffer->line_count);
+	return 1;
+}
+
+static int nk_love_text_buffer_get_line(lua_State *L)
+{
+	nk_love_text_buffer_assert(L, lua_gettop(L) == 2, "wrong number of arguments to '%s'");
+	struct nk_love_text_buffer *buffer = nk_love_checkTextBuffer(L, 1);
+	int line = luaL_checkint(L, 2);
+	nk_love_text_buffer_index(L, buffer);
+	nk_love_text_buffer_assert(L, line >= 1 && line <= buffer->line_count, "%s: line out of range");
+	const char *text = (const char *) nk_str_get_const(&buffer->edit.string);
+	nk_size start = buffer->lines[line - 1];
+	nk_size end = (nk_size) nk_str_len_char(&buffer->edit.string);
+	if (line < buffer->line_count)
+		end = buffer->lines[line] - 1;
+	lua_pushlstring(L, text ? text + start : "", end - start);
+	return 1;
+}
+
+static const luaL_Reg text_buffer_methods[] = {
+	{"getText", nk_love_text_buffer_get_text},
+	{"setText", nk_love_text_buffer_set_text},
+	{"getLength", nk_love_text_buffer_get_length},
+	{"getLineCount", nk_love_text_buffer_get_line_count},
+	{"getLine", nk_love_text_buffer_get_line},
+	{NULL, NULL}
+};
+
+static int nk_love_new_text_buffer(lua_State *L)
+{
+	nk_love_text_buffer_assert(L, lua_gettop(L) <= 1, "wrong number of arguments to '%s'");
+	size_t len = 0;
+	const char *text = "";
+	if (lua_gettop(L) == 1)
+		text = luaL_checklstring(L, 1, &len);
+	struct nk_love_text_buffer *buffer = (struct nk_love_text_buffer *)
+		lua_newuserdata(L, sizeof(struct nk_love_text_buffer));
+	nk_zero(buffer, sizeof(struct nk_love_text_buffer));
+	nk_textedit_init_default(&buffer->edit);
+	if (luaL_newmetatable(L, NK_LOVE_TEXT_BUFFER)) {
+		lua_pushcfunction(L, nk_love_text_buffer_gc);
+		lua_setfield(L, -2, "__gc");
+		lua_newtable(L);
+		luaL_register(L, NULL, text_buffer_methods);
+		lua_setfield(L, -2, "__index");
+	}
+	lua_setmetatable(L, -2);
+	nk_love_text_buffer_set(buffer, text, len);
+	return 1;
+}
+
+static void nk_love_push_edit_event(nk_flags event)
 {
-	nk_love_assert_argc(lua_gettop(L) == 2);
-	nk_flags flags = nk_love_checkedittype(1);
-	if (!lua_istable(L, 2))
-		luaL_typerror(L, 2, "table");
-	lua_getfield(L, 2, "value");
-	if (!lua_isstring(L, -1))
-		luaL_argerror(L, 2, "should have a string value");
-	const char *value = lua_tostring(L, -1);
-	size_t len = NK_CLAMP(0, strlen(value), NK_LOVE_EDIT_BUFFER_LEN - 1);
-	memcpy(edit_buffer, value, len);
-	edit_buffer[len] = '\0';
-	nk_flags event = nk_edit_string_zero_terminated(&context, flags, edit_buffer, NK_LOVE_EDIT_BUFFER_LEN - 1, nk_filter_default);
-	lua_pushstring(L, edit_buffer);
-	lua_pushvalue(L, -1);
-	lua_setfield(L, 2, "value");
-	int changed = !lua_equal(L, -1, -2);
 	if (event & NK_EDIT_COMMITED)
 		lua_pushstring(L, "commited");
 	else if (event & NK_EDIT_ACTIVATED)
@@ -2157,6 +4694,113 @@ static int nk_love_edit(lua_State *L)
 		lua_pushstring(L, "inactive");
 	else
 		lua_pushnil(L);
+}
+
+/* Position of nuklear's undo history, which moves with every edit. */
+struct nk_love_undo_mark {
+	short undo_point;
+	short redo_point;
+	short undo_char_point;
+	short redo_char_point;
+	struct nk_text_undo_record newest;
+};
+
+static void nk_love_undo_mark(const struct nk_text_edit *edit, struct nk_love_undo_mark *mark)
+{
+	const struct nk_text_undo_state *undo = &edit->undo;
+	mark->undo_point = undo->undo_point;
+	mark->redo_point = undo->redo_point;
+	mark->undo_char_point = undo->undo_char_point;
+	mark->redo_char_point = undo->redo_char_point;
+	nk_zero_struct(mark->newest);
+	if (undo->undo_point > 0)
+		mark->newest = undo->undo_rec[undo->undo_point - 1];
+}
+
+static int nk_love_undo_moved(const struct nk_love_undo_mark *a, const struct nk_love_undo_mark *b)
+{
+	return a->undo_point != b->undo_point
+		|| a->redo_point != b->redo_point
+		|| a->undo_char_point != b->undo_char_point
+		|| a->redo_char_point != b->redo_char_point
+		|| a->newest.where != b->newest.where
+		|| a->newest.insert_length != b->newest.insert_length
+		|| a->newest.delete_length != b->newest.delete_length
+		|| a->newest.char_storage != b->newest.char_storage;
+}
+
+/*
+ * Edit a text buffer in place. A new length proves a change; otherwise a
+ * same-length edit (typing over a selection, undo, redo) is found from the
+ * undo history, so the cost does not depend on the document size. The
+ * frame that activates the field resets that history, so it only counts
+ * as a change when the length moved.
+ */
+static int nk_love_edit_text_buffer(nk_flags flags, struct nk_love_text_buffer *buffer)
+{
+	int len = nk_str_len_char(&buffer->edit.string);
+	struct nk_love_undo_mark before, after;
+	nk_love_undo_mark(&buffer->edit, &before);
+	nk_flags event = nk_edit_buffer(&context, flags, &buffer->edit, nk_filter_default);
+	int changed = len != nk_str_len_char(&buffer->edit.string);
+	if (!changed && !(event & NK_EDIT_ACTIVATED)) {
+		nk_love_undo_mark(&buffer->edit, &after);
+		changed = nk_love_undo_moved(&before, &after);
+	}
+	if (changed)
+		buffer->lines_dirty = 1;
+	nk_love_push_edit_event(event);
+	lua_pushboolean(L, changed);
+	return 2;
+}
+
+/*
+ * Bytes a live field can need this frame: its text plus what the input
+ * may insert, which is the typed text, a paste or an undo or redo.
+ */
+static nk_size nk_love_edit_need(nk_size len)
+{
+	struct nk_keyboard *keyboard = &context.input.keyboard;
+	nk_size need = len + keyboard->text_len + 1;
+	if (keyboard->keys[NK_KEY_PASTE].clicked)
+		need += nk_love_clipboard_length();
+	if (keyboard->keys[NK_KEY_TEXT_UNDO].clicked || keyboard->keys[NK_KEY_TEXT_REDO].clicked)
+		need += NK_TEXTEDIT_UNDOCHARCOUNT * 4;
+	return NK_MIN(need, edit_buffer_len);
+}
+
+static int nk_love_edit(lua_State *L)
+{
+	nk_love_assert_argc(lua_gettop(L) == 2);
+	nk_flags flags = nk_love_checkedittype(1);
+	if (nk_love_is_text_buffer(2))
+		return nk_love_edit_text_buffer(flags, nk_love_checkTextBuffer(L, 2));
+	if (!lua_istable(L, 2))
+		luaL_typerror(L, 2, "table or text buffer");
+	lua_getfield(L, 2, "value");
+	if (!lua_isstring(L, -1))
+		luaL_argerror(L, 2, "should have a string value");
+	size_t value_len;
+	const char *value = lua_tolstring(L, -1, &value_len);
+	int len = (int) NK_MIN(value_len, edit_buffer_len - 1);
+	int changed = 0;
+	nk_flags event;
+	if (!nk_love_edit_is_live()) {
+		/* an inactive field only reads its text, so draw the Lua string in place */
+		event = nk_edit_string(&context, flags, (char *) value, &len, len, nk_filter_default);
+	} else {
+		nk_size need = nk_love_edit_need(len);
+		edit_buffer = (char *) nk_love_reserve(edit_buffer, &edit_buffer_size, need, 1);
+		memcpy(edit_buffer, value, len);
+		event = nk_edit_string(&context, flags, edit_buffer, &len,
+			(int) NK_MIN(edit_buffer_size, edit_buffer_len) - 1, nk_filter_default);
+		changed = (size_t) len != value_len || memcmp(edit_buffer, value, len);
+		if (changed) {
+			lua_pushlstring(L, edit_buffer, len);
+			lua_setfield(L, 2, "value");
+		}
+	}
+	nk_love_push_edit_event(event);
 	lua_pushboolean(L, changed);
 	return 2;
 }
@@ -2197,15 +4841,28 @@ static int nk_love_combobox(lua_State *L)
 	nk_love_assert_argc(argc >= 2 && argc <= 5);
 	if (!lua_istable(L, 2))
 		luaL_typerror(L, 2, "table");
-	int i;
-	for (i = 0; i < NK_LOVE_COMBOBOX_MAX_ITEMS && lua_checkstack(L, 4); ++i) {
+	int i, scratch = 0;
+	for (i = 0; i < combobox_max_items; ++i) {
 		lua_rawgeti(L, 2, i + 1);
-		if (lua_isstring(L, -1))
-			combobox_items[i] = lua_tostring(L, -1);
-		else if (lua_isnil(L, -1))
+		if (lua_isnil(L, -1))
 			break;
-		else
+		if (!lua_isstring(L, -1))
 			luaL_argerror(L, 2, "items must be strings");
+		combobox_items = (const char **) nk_love_reserve(combobox_items, &combobox_capacity, i + 1, sizeof(char*));
+		if (lua_type(L, -1) == LUA_TSTRING) {
+			/* the items table keeps the string alive, so it can come off the stack */
+			combobox_items[i] = lua_tostring(L, -1);
+			lua_pop(L, 1);
+		} else {
+			/* a number converts to a string only the stack holds; keep it in a scratch table */
+			if (!scratch) {
+				lua_newtable(L);
+				lua_insert(L, -2);
+				scratch = lua_gettop(L) - 1;
+			}
+			combobox_items[i] = lua_tostring(L, -1);
+			lua_rawseti(L, scratch, i + 1);
+		}
 	}
 	struct nk_rect bounds = nk_widget_bounds(&context);
 	int item_height = bounds.h;
@@ -2567,8 +5224,10 @@ static int nk_love_style_load_colors(lua_State *L)
 static int nk_love_style_set_font(lua_State *L)
 {
 	nk_love_assert_argc(lua_gettop(L) == 1);
-	nk_love_checkFont(1, &fonts[font_count]);
-	nk_style_set_font(&context, &fonts[font_count++]);
+	struct nk_user_font *font = nk_love_font_slot(font_count);
+	nk_love_checkFont(1, font);
+	font_count++;
+	nk_style_set_font(&context, font);
 	return 0;
 }
 
@@ -2657,8 +5316,10 @@ static int nk_love_style_push_float(float *field) {
 
 static int nk_love_style_push_font(const struct nk_user_font **field)
 {
-	nk_love_checkFont(-1, &fonts[font_count]);
-	int success = nk_style_push_font(&context, &fonts[font_count++]);
+	struct nk_user_font *font = nk_love_font_slot(font_count);
+	nk_love_checkFont(-1, font);
+	font_count++;
+	int success = nk_style_push_font(&context, font);
 	if (success) {
 		lua_pushstring(L, "font");
 		size_t stack_size = lua_objlen(L, 1);
@@ -3146,19 +5807,32 @@ static int nk_love_spacing(lua_State *L)
 	return 0;
 }
 
+/*
+ * Nuklear stores at most NK_LOVE_MAX_POINTS points in one polyline or
+ * polygon command. Longer lines are split into chained polylines that
+ * share their joining point; longer polygons are an error.
+ */
 static int nk_love_line(lua_State *L)
 {
 	int argc = lua_gettop(L);
 	nk_love_assert_argc(argc >= 4 && argc % 2 == 0);
+	float *points = (float *) nk_love_arena_alloc(sizeof(float) * argc);
+	nk_love_assert_alloc(points);
 	int i;
 	for (i = 0; i < argc; ++i) {
 		nk_love_assert(lua_isnumber(L, i + 1), "%s: point coordinates should be numbers");
-		floats[i] = lua_tonumber(L, i + 1);
+		points[i] = lua_tonumber(L, i + 1);
 	}
 	float line_thickness;
 	struct nk_color color;
 	nk_love_getGraphics(&line_thickness, &color);
-	nk_stroke_polyline(&context.current->buffer, floats, argc / 2, line_thickness, color);
+	int count = argc / 2;
+	int start = 0;
+	while (count - start > NK_LOVE_MAX_POINTS) {
+		nk_stroke_polyline(&context.current->buffer, points + 2 * start, NK_LOVE_MAX_POINTS, line_thickness, color);
+		start += NK_LOVE_MAX_POINTS - 1;
+	}
+	nk_stroke_polyline(&context.current->buffer, points + 2 * start, count - start, line_thickness, color);
 	return 0;
 }
 
@@ -3186,18 +5860,21 @@ static int nk_love_polygon(lua_State *L)
 	int argc = lua_gettop(L);
 	nk_love_assert_argc(argc >= 7 && argc % 2 == 1);
 	enum nk_love_draw_mode mode = nk_love_checkdraw(1);
+	nk_love_assert((argc - 1) / 2 <= NK_LOVE_MAX_POINTS, "%s: polygons are limited to 65535 points");
+	float *points = (float *) nk_love_arena_alloc(sizeof(float) * (argc - 1));
+	nk_love_assert_alloc(points);
 	int i;
 	for (i = 0; i < argc - 1; ++i) {
 		nk_love_assert(lua_isnumber(L, i + 2), "%s: point coordinates should be numbers");
-		floats[i] = lua_tonumber(L, i + 2);
+		points[i] = lua_tonumber(L, i + 2);
 	}
 	float line_thickness;
 	struct nk_color color;
 	nk_love_getGraphics(&line_thickness, &color);
 	if (mode == NK_LOVE_FILL)
-		nk_fill_polygon(&context.current->buffer, floats, (argc - 1) / 2, color);
+		nk_fill_polygon(&context.current->buffer, points, (argc - 1) / 2, color);
 	else if (mode == NK_LOVE_LINE)
-		nk_stroke_polygon(&context.current->buffer, floats, (argc - 1) / 2, line_thickness, color);
+		nk_stroke_polygon(&context.current->buffer, points, (argc - 1) / 2, line_thickness, color);
 	return 0;
 }
 
@@ -3289,15 +5966,21 @@ static int nk_love_text(lua_State *L)
 	float y = luaL_checknumber(L, 3);
 	float w = luaL_checknumber(L, 4);
 	float h = luaL_checknumber(L, 5);
-	lua_getglobal(L, "love");
-	lua_getfield(L, -1, "graphics");
-	lua_getfield(L, -1, "getFont");
-	lua_call(L, 0, 1);
-	nk_love_checkFont(-1, &fonts[font_count]);
+	const struct nk_user_font *font = context.style.font;
+	if (lg) {
+		lua_getglobal(L, "love");
+		lua_getfield(L, -1, "graphics");
+		lua_getfield(L, -1, "getFont");
+		lua_call(L, 0, 1);
+		struct nk_user_font *slot = nk_love_font_slot(font_count);
+		nk_love_checkFont(-1, slot);
+		font_count++;
+		font = slot;
+	}
 	float line_thickness;
 	struct nk_color color;
 	nk_love_getGraphics(&line_thickness, &color);
-	nk_draw_text(&context.current->buffer, nk_rect(x, y, w, h), text, strlen(text), &fonts[font_count++], nk_rgba(0, 0, 0, 0), color);
+	nk_draw_text(&context.current->buffer, nk_rect(x, y, w, h), text, strlen(text), font, nk_rgba(0, 0, 0, 0), color);
 	return 0;
 }
 
@@ -3388,11 +6071,18 @@ static const luaL_Reg functions[] =
 	{"wheelmoved", nk_love_wheelmoved},
 
 	{"draw", nk_love_draw},
+	{"getStats", nk_love_get_stats},
+	{"dumpTrace", nk_love_dump_trace},
+	{"takeRecording", nk_love_take_recording},
+	{"recordBegin", nk_love_input_record_begin},
+	{"recordEnd", nk_love_input_record_end},
+	{"replay", nk_love_replay},
 
 	{"frame_begin", nk_love_frame_begin},
 	{"frameBegin", nk_love_frame_begin},
 	{"frame_end", nk_love_frame_end},
 	{"frameEnd", nk_love_frame_end},
+	{"frameChanged", nk_love_frame_changed},
 
 	{"window_begin", nk_love_window_begin},
 	{"windowBegin", nk_love_window_begin},
@@ -3503,6 +6193,7 @@ static const luaL_Reg functions[] =
 	{"colorPicker", nk_love_color_picker},
 	{"property", nk_love_property},
 	{"edit", nk_love_edit},
+	{"newTextBuffer", nk_love_new_text_buffer},
 	{"popup_begin", nk_love_popup_begin},
 	{"popupBegin", nk_love_popup_begin},
 	{"popup_close", nk_love_popup_close},
@@ -3602,6 +6293,18 @@ static const lua_CFunction types[] =
 	0
 };
 
+#ifdef NK_LOVE_TRACE
+/* Stand-in for every registered function that records a zone per call. */
+static int nk_love_traced(lua_State *L)
+{
+	const luaL_Reg *reg = &functions[lua_tointeger(L, lua_upvalueindex(1))];
+	NK_LOVE_ZONE_BEGIN(start);
+	int results = reg->func(L);
+	NK_LOVE_ZONE_END(reg->name, start);
+	return results;
+}
+#endif
+
 extern "C" int luaopen_nuklear(lua_State *L)
 {
 	WrappedModule w;
@@ -3611,7 +6314,16 @@ extern "C" int luaopen_nuklear(lua_State *L)
 	w.functions = functions;
 	w.types = types;
 
-	return luax_register_module(L, w);
+	int results = luax_register_module(L, w);
+#ifdef NK_LOVE_TRACE
+	int i;
+	for (i = 0; functions[i].name; ++i) {
+		lua_pushinteger(L, i);
+		lua_pushcclosure(L, nk_love_traced, 1);
+		lua_setfield(L, -2, functions[i].name);
+	}
+#endif
+	return results;
 }
 
 #undef NK_LOVE_REGISTER